@@ -11,6 +11,13 @@
 
 #include "ioutil.hpp"
 #include "kristall.hpp"
+#include "tracer.hpp"
+#include "stalldetector.hpp"
+#include "preconnector.hpp"
+#include "prefetcher.hpp"
+#include "requestcoalescer.hpp"
+#include "networkthread.hpp"
+#include "documentpatch.hpp"
 
 #include <cassert>
 #include <QTabWidget>
@@ -24,42 +31,68 @@
 #include <QMimeDatabase>
 #include <QMimeType>
 #include <QImageReader>
+#include <QUrlQuery>
+#include <QTextBlock>
+#include <QSet>
+#include <QCoreApplication>
+#include <QScrollBar>
 
 #include <QGraphicsPixmapItem>
 #include <QGraphicsTextItem>
+#include <QtGlobal>
 
 
+static int next_tab_id = 1;
+
+//! Calls `slot` of `tab` for each `signal` of `client`. The call is queued
+//! to `receiver` and dropped when `receiver` is deleted before.
+template<typename Client, typename... Args>
+static void forwardSignal(Client * client, void (Client::*signal)(Args...), QObject * receiver, BrowserTab * tab, void (BrowserTab::*slot)(Args...))
+{
+    QObject::connect(client, signal, receiver, [tab, slot](Args... args) {
+        (tab->*slot)(args...);
+    });
+}
+
+//! Returns the absolute targets of all links in `document`.
+static QList<QUrl> documentLinks(QTextDocument const & document, QUrl const & base)
+{
+    QList<QUrl> links;
+    for(QTextBlock block = document.begin(); block != document.end(); block = block.next())
+    {
+        for(auto it = block.begin(); not it.atEnd(); ++it)
+        {
+            auto const format = it.fragment().charFormat();
+            if(not format.isAnchor())
+                continue;
+            QUrl const url = base.resolved(QUrl(format.anchorHref()));
+            if(links.isEmpty() or links.last() != url)
+                links.append(url);
+        }
+    }
+    return links;
+}
+
 BrowserTab::BrowserTab(MainWindow * mainWindow) :
     QWidget(nullptr),
     ui(new Ui::BrowserTab),
     mainWindow(mainWindow),
+    tab_id(next_tab_id++),
+    gemini_client(new GeminiClient()),
+    web_client(new WebClient()),
+    gopher_client(new GopherClient()),
+    finger_client(new FingerClient()),
     outline(),
     graphics_scene()
 {
     ui->setupUi(this);
 
-    connect(&web_client, &WebClient::requestComplete, this, &BrowserTab::on_requestComplete);
-    connect(&web_client, &WebClient::requestFailed, this, &BrowserTab::on_requestFailed);
-    connect(&web_client, &WebClient::requestProgress, this, &BrowserTab::on_requestProgress);
-
-    connect(&gemini_client, &GeminiClient::requestComplete, this, &BrowserTab::on_requestComplete);
-    connect(&gemini_client, &GeminiClient::requestProgress, this, &BrowserTab::on_requestProgress);
-    connect(&gemini_client, &GeminiClient::protocolViolation, this, &BrowserTab::on_protocolViolation);
-    connect(&gemini_client, &GeminiClient::inputRequired, this, &BrowserTab::on_inputRequired);
-    connect(&gemini_client, &GeminiClient::redirected, this, &BrowserTab::on_redirected);
-    connect(&gemini_client, &GeminiClient::temporaryFailure, this, &BrowserTab::on_temporaryFailure);
-    connect(&gemini_client, &GeminiClient::permanentFailure, this, &BrowserTab::on_permanentFailure);
-    connect(&gemini_client, &GeminiClient::transientCertificateRequested, this, &BrowserTab::on_transientCertificateRequested);
-    connect(&gemini_client, &GeminiClient::authorisedCertificateRequested, this, &BrowserTab::on_authorisedCertificateRequested);
-    connect(&gemini_client, &GeminiClient::certificateRejected, this, &BrowserTab::on_certificateRejected);
-
-    connect(&gopher_client, &GopherClient::requestComplete, this, &BrowserTab::on_requestComplete);
-    connect(&gopher_client, &GopherClient::requestFailed, this, &BrowserTab::on_requestFailed);
-    connect(&gopher_client, &GopherClient::requestProgress, this, &BrowserTab::on_requestProgress);
-
-    connect(&finger_client, &FingerClient::requestComplete, this, &BrowserTab::on_requestComplete);
-    connect(&finger_client, &FingerClient::requestFailed, this, &BrowserTab::on_requestFailed);
-    connect(&finger_client, &FingerClient::requestProgress, this, &BrowserTab::on_requestProgress);
+    NetworkThread::adopt(gemini_client);
+    NetworkThread::adopt(web_client);
+    NetworkThread::adopt(gopher_client);
+    NetworkThread::adopt(finger_client);
+
+    this->resetClientReceiver();
 
     this->updateUI();
 
@@ -68,64 +101,109 @@ BrowserTab::BrowserTab(MainWindow * mainWindow) :
     this->ui->text_browser->setVisible(true);
 
     this->ui->text_browser->setContextMenuPolicy(Qt::CustomContextMenu);
+
+    connect(&this->auto_refresh_timer, &QTimer::timeout, this, [this]() {
+        // Ticks while the page is still loading are skipped
+        if(this->successfully_loaded and not this->is_hibernated)
+            this->reloadPage();
+    });
 }
 
 BrowserTab::~BrowserTab()
 {
+    // Ends the foreground request of a tab closed while loading
+    this->logRequest(QString { }, 0, "Cancelled");
+
+    RequestCoalescer::leave(this);
+
+    // Deleted on the network thread, which also closes their connections
+    gemini_client->deleteLater();
+    web_client->deleteLater();
+    gopher_client->deleteLater();
+    finger_client->deleteLater();
+
     delete ui;
 }
 
-void BrowserTab::navigateTo(const QUrl &url, PushToHistory mode)
+void BrowserTab::navigateTo(const QUrl &requested_url, PushToHistory mode)
 {
+    // Skip permanent redirects we have already seen
+    QUrl const url = global_redirect_cache.resolve(requested_url);
+
     if(mainWindow->protocols.isSchemeSupported(url.scheme()) != ProtocolSetup::Enabled)
     {
         QMessageBox::warning(this, "Kristall", "URI scheme not supported or disabled: " + url.scheme());
         return;
     }
 
-    this->timer.start();
+    TraceScope trace { "navigation", "BrowserTab::navigateTo", this->tab_id, url };
+
+    // The previous request still owns the timing and the location
+    this->logRequest(QString { }, 0, "Cancelled");
+
+    this->timing.start(RequestTiming::Navigate);
+
+    // Loading the shown page again patches the current document
+    this->is_reloading = (url == this->current_location)
+        and this->successfully_loaded
+        and this->current_document != nullptr;
+    if(url != this->current_location) {
+        this->auto_refresh_timer.stop();
+    }
 
     this->current_location = url;
     this->ui->url_bar->setText(url.toString(QUrl::FormattingOptions(QUrl::FullyEncoded)));
 
-    if(not gemini_client.cancelRequest()) {
+    this->is_hibernated = false;
+    this->hibernated_buffer = QByteArray { };
+
+    if(not gemini_client->cancelRequest()) {
         QMessageBox::warning(this, "Kristall", "Failed to cancel running gemini request!");
         return;
     }
 
-    if(not web_client.cancelRequest()) {
+    if(not web_client->cancelRequest()) {
         QMessageBox::warning(this, "Kristall", "Failed to cancel running web request!");
         return;
     }
 
-    if(not gopher_client.cancelRequest()) {
+    if(not gopher_client->cancelRequest()) {
         QMessageBox::warning(this, "Kristall", "Failed to cancel running gopher request!");
         return;
     }
 
-    if(not finger_client.cancelRequest()) {
+    if(not finger_client->cancelRequest()) {
         QMessageBox::warning(this, "Kristall", "Failed to cancel running finger request!");
         return;
     }
 
+    this->resetClientReceiver();
+
     this->redirection_count = 0;
     this->successfully_loaded = false;
-
-    if(url.scheme() == "gemini")
-    {
-        gemini_client.startRequest(url);
-    }
-    else if(url.scheme() == "http" or url.scheme() == "https")
-    {
-        web_client.startRequest(url);
+    this->is_streaming_document = false;
+    this->gophermap_stream.reset();
+
+    this->coalescing_key.clear();
+    RequestCoalescer::leave(this);
+
+    this->current_record = RequestRecord { };
+    this->current_record.tab_id = this->tab_id;
+    this->current_record.url = requested_url;
+    this->current_record.protocol = url.scheme();
+    this->current_record.started = QDateTime::currentDateTime();
+    if(url != requested_url) {
+        this->current_record.redirects.append(url);
     }
-    else if(url.scheme() == "gopher")
-    {
-        gopher_client.startRequest(url);
+    this->is_logging_request = this->clientTiming().has_value();
+
+    if(this->is_logging_request) {
+        Prefetcher::beginForeground(url);
     }
-    else if(url.scheme() == "finger")
+
+    if(this->is_logging_request)
     {
-        finger_client.startRequest(url);
+        this->startNetworkRequest(url);
     }
     else if(url.scheme() == "file")
     {
@@ -165,6 +243,58 @@ void BrowserTab::navigateTo(const QUrl &url, PushToHistory mode)
 
             this->on_requestComplete(document, "text/gemini");
         }
+        else if(url.path() == "memory")
+        {
+            QUrlQuery query { url };
+            if(query.hasQueryItem("hibernate")) {
+                this->mainWindow->hibernateBackgroundTabs();
+            }
+            if(query.hasQueryItem("trim")) {
+                MemoryReport::trimCaches();
+            }
+
+            this->on_requestComplete(MemoryReport::toGemini(this->mainWindow->tabs()), "text/gemini");
+        }
+        else if(url.path() == "network")
+        {
+            QUrlQuery query { url };
+            if(query.hasQueryItem("clear")) {
+                global_request_log.clear();
+            }
+
+            auto const sort = RequestLog::parseSortKey(query.queryItemValue("sort"));
+            if(query.queryItemValue("format") == "csv") {
+                this->on_requestComplete(global_request_log.toCsv(sort), "text/csv");
+            } else {
+                this->on_requestComplete(global_request_log.toGemini(sort), "text/gemini");
+            }
+        }
+        else if(url.path() == "known-hosts")
+        {
+            QUrlQuery query { url };
+            if(query.hasQueryItem("forget")) {
+                global_known_hosts.forget(query.queryItemValue("forget", QUrl::FullyDecoded));
+            }
+            this->on_requestComplete(global_known_hosts.toGemini(), "text/gemini");
+        }
+        else if(url.path() == "redirects")
+        {
+            QUrlQuery query { url };
+            if(query.hasQueryItem("forget")) {
+                global_redirect_cache.forget(query.queryItemValue("forget", QUrl::FullyDecoded));
+            }
+            if(query.hasQueryItem("clear")) {
+                global_redirect_cache.clear();
+            }
+            this->on_requestComplete(global_redirect_cache.toGemini(), "text/gemini");
+        }
+        else if(url.path() == "stalls")
+        {
+            if(QUrlQuery(url).hasQueryItem("clear")) {
+                StallDetector::clear();
+            }
+            this->on_requestComplete(StallDetector::toGemini(), "text/gemini");
+        }
         else
         {
             QFile file(QString(":/about/%1.gemini").arg(url.path()));
@@ -193,6 +323,57 @@ void BrowserTab::navigateTo(const QUrl &url, PushToHistory mode)
     this->updateUI();
 }
 
+void BrowserTab::startNetworkRequest(const QUrl &url)
+{
+    if(url.scheme() == "gemini") {
+        this->applyIdentity(url);
+    }
+
+    ResponseCache::Entry cached;
+    if(url.scheme() == "gemini" and not this->current_identitiy.isValid() and global_response_cache.take(url, cached))
+    {
+        this->current_record.cache_hit = true;
+        this->current_record.status = "20";
+        this->on_requestComplete(cached.body, cached.mime);
+        return;
+    }
+
+    // The host told us recently that this page doesn't exist
+    RedirectCache::Failure failure;
+    if(url.scheme() == "gemini" and global_redirect_cache.findFailure(url, failure))
+    {
+        this->current_record.cache_hit = true;
+        this->current_record.status = QString::number(failure.status);
+        this->on_permanentFailure(failure.status == 52 ? PermanentFailure::gone : PermanentFailure::not_found, failure.meta);
+        return;
+    }
+
+    // Another tab is already loading this page, wait for its response
+    auto const key = this->requestKey(url);
+    if(RequestCoalescer::join(key, this))
+    {
+        this->coalescing_key = key;
+        return;
+    }
+
+    if(url.scheme() == "gemini")
+    {
+        gemini_client->startRequest(url);
+    }
+    else if(url.scheme() == "http" or url.scheme() == "https")
+    {
+        web_client->startRequest(url);
+    }
+    else if(url.scheme() == "gopher")
+    {
+        gopher_client->startRequest(url);
+    }
+    else if(url.scheme() == "finger")
+    {
+        finger_client->startRequest(url);
+    }
+}
+
 void BrowserTab::navigateBack(QModelIndex history_index)
 {
     auto url = history.get(history_index);
@@ -221,8 +402,11 @@ void BrowserTab::scrollToAnchor(QString const & anchor)
 
 void BrowserTab::reloadPage()
 {
-    if(current_location.isValid())
+    if(current_location.isValid()) {
+        // Reloading retries pages that were not found before
+        global_redirect_cache.removeFailure(this->current_location);
         this->navigateTo(this->current_location, DontPush);
+    }
 }
 
 void BrowserTab::toggleIsFavourite()
@@ -247,6 +431,62 @@ void BrowserTab::focusUrlBar()
     this->ui->url_bar->selectAll();
 }
 
+TabMemoryUsage BrowserTab::memoryUsage() const
+{
+    TabMemoryUsage usage;
+
+    usage.buffer = this->current_buffer.capacity();
+    usage.hibernated = this->hibernated_buffer.capacity();
+    usage.document = MemoryReport::estimateDocument(this->current_document.get());
+
+    for(auto const * item : this->graphics_scene.items())
+    {
+        if(auto const * pixmap_item = qgraphicsitem_cast<QGraphicsPixmapItem const *>(item); pixmap_item != nullptr) {
+            auto const pixmap = pixmap_item->pixmap();
+            usage.images += qint64(pixmap.width()) * pixmap.height() * pixmap.depth() / 8;
+        }
+    }
+
+    usage.media = this->ui->media_browser->bufferSize();
+    usage.outline = this->outline.estimateMemoryUsage();
+    usage.history = this->history.estimateMemoryUsage();
+
+    return usage;
+}
+
+void BrowserTab::hibernate()
+{
+    if(this->is_hibernated or not this->successfully_loaded)
+        return;
+
+    // Media continues playing in background tabs
+    if(this->current_mime.startsWith("video/") or this->current_mime.startsWith("audio/"))
+        return;
+
+    this->hibernated_buffer = qCompress(this->current_buffer);
+    this->current_buffer = QByteArray { };
+
+    this->ui->text_browser->setDocument(nullptr);
+    this->current_document.reset();
+    this->graphics_scene.clear();
+    this->outline.clear();
+
+    this->is_hibernated = true;
+}
+
+void BrowserTab::wakeUp()
+{
+    if(not this->is_hibernated)
+        return;
+    this->is_hibernated = false;
+
+    auto const data = qUncompress(this->hibernated_buffer);
+    this->hibernated_buffer = QByteArray { };
+
+    this->timing.start(RequestTiming::Navigate);
+    this->on_requestComplete(data, this->current_mime);
+}
+
 void BrowserTab::on_url_bar_returnPressed()
 {
     QUrl url { this->ui->url_bar->text() };
@@ -268,66 +508,179 @@ void BrowserTab::on_requestFailed(const QString &reason)
     this->setErrorMessage(QString("Request failed:\n%1").arg(reason));
 }
 
-void BrowserTab::on_requestComplete(const QByteArray &data, const QString &mime)
+void BrowserTab::restyle()
 {
-    qDebug() << "Loaded" << data.length() << "bytes of type" << mime;
+    if(this->style_revision == StyleCache::revision() or this->is_hibernated)
+        return;
 
-    this->current_mime = mime;
-    this->current_buffer = data;
+    // The response of a running request is styled when it is complete
+    if(not this->successfully_loaded or this->is_streaming_document or this->current_document == nullptr)
+        return;
 
-    this->graphics_scene.clear();
-    this->ui->text_browser->setText("");
+    // Images and media have no styles
+    if(this->current_mime.startsWith("image/") or this->current_mime.startsWith("video/") or this->current_mime.startsWith("audio/"))
+        return;
 
-    ui->text_browser->setStyleSheet("");
+    TraceScope trace { "render", "BrowserTab::restyle", this->tab_id, this->current_location };
+    StallScope stall { "BrowserTab::restyle", this->current_location };
 
-    enum DocumentType { Text, Image, Media };
+    auto * scroll_bar = this->ui->text_browser->verticalScrollBar();
+    int const scroll_position = scroll_bar->value();
 
-    DocumentType doc_type = Text;
-    std::unique_ptr<QTextDocument> document;
+    bool plaintext_only = (global_settings.value("text_display").toString() == "plain");
+    bool const is_rich_text = not plaintext_only
+        and (this->current_mime.startsWith("text/html") or this->current_mime.startsWith("text/markdown"));
 
-    this->outline.clear();
+    auto const render_style = StyleCache::get(mainWindow->current_style, this->current_location);
 
-    auto doc_style = mainWindow->current_style.derive(this->current_location);
+    if(is_rich_text or not this->current_mime.startsWith("text/"))
+    {
+        // HTML, Markdown and info pages get their styles when they are built
+        auto document = this->renderDocument(this->current_buffer, this->current_mime, *render_style);
+        this->ui->text_browser->setDocument(document.get());
+        this->current_document = std::move(document);
+    }
+    else
+    {
+        render_style->restyle(*this->current_document);
+        if(auto * gemini_document = qobject_cast<GeminiDocument*>(this->current_document.get())) {
+            gemini_document->background_color = render_style->style.background_color;
+        }
+    }
 
-    this->ui->text_browser->setStyleSheet(QString("QTextBrowser { background-color: %1; }").arg(doc_style.background_color.name()));
+    this->ui->text_browser->setStyleSheet(QString("QTextBrowser { background-color: %1; }").arg(render_style->style.background_color.name()));
+    this->style_revision = StyleCache::revision();
+
+    scroll_bar->setValue(scroll_position);
+}
+
+std::unique_ptr<QTextDocument> BrowserTab::renderDocument(const QByteArray &data, const QString &mime, const RenderStyle &render_style)
+{
+    auto const & doc_style = render_style.style;
 
     bool plaintext_only = (global_settings.value("text_display").toString() == "plain");
 
+    std::unique_ptr<QTextDocument> document;
     if(not plaintext_only and mime.startsWith("text/gemini")) {
+        StallScope stall { "GeminiRenderer::render", this->current_location, data.size() };
         document = GeminiRenderer::render(
             data,
             this->current_location,
-            doc_style,
+            render_style,
             this->outline);
     }
     else if(not plaintext_only and mime.startsWith("text/gophermap")) {
+        StallScope stall { "GophermapRenderer::render", this->current_location, data.size() };
         document = GophermapRenderer::render(
             data,
             this->current_location,
-            doc_style);
+            render_style);
     }
     else if(not plaintext_only and mime.startsWith("text/finger")) {
-        document = PlainTextRenderer::render(data, doc_style);
+        StallScope stall { "PlainTextRenderer::render", this->current_location, data.size() };
+        document = PlainTextRenderer::render(data, render_style);
     }
     else if(not plaintext_only and mime.startsWith("text/html")) {
+        TraceScope trace { "render", "QTextDocument::setHtml", this->tab_id };
+        StallScope stall { "QTextDocument::setHtml", this->current_location, data.size() };
         document = std::make_unique<QTextDocument>();
 
         document->setDefaultFont(doc_style.standard_font);
-        document->setDefaultStyleSheet(doc_style.toStyleSheet());
+        document->setDefaultStyleSheet(render_style.style_sheet);
         document->setDocumentMargin(doc_style.margin);
         document->setHtml(QString::fromUtf8(data));
     }
 #if defined(QT_FEATURE_textmarkdownreader)
     else if(not plaintext_only and mime.startsWith("text/markdown")) {
+        TraceScope trace { "render", "QTextDocument::setMarkdown", this->tab_id };
+        StallScope stall { "QTextDocument::setMarkdown", this->current_location, data.size() };
         document = std::make_unique<QTextDocument>();
         document->setDefaultFont(doc_style.standard_font);
-        document->setDefaultStyleSheet(doc_style.toStyleSheet());
+        document->setDefaultStyleSheet(render_style.style_sheet);
         document->setDocumentMargin(doc_style.margin);
         document->setMarkdown(QString::fromUtf8(data));
     }
 #endif
     else if(mime.startsWith("text/")) {
-        document = PlainTextRenderer::render(data, doc_style);
+        StallScope stall { "PlainTextRenderer::render", this->current_location, data.size() };
+        document = PlainTextRenderer::render(data, render_style);
+    }
+    else {
+        document = std::make_unique<QTextDocument>();
+        document->setDefaultFont(doc_style.standard_font);
+        document->setDefaultStyleSheet(render_style.style_sheet);
+
+        document->setPlainText(QString(R"md(You accessed an unsupported media type!
+
+Use the *File* menu to save the file to your local disk or navigate somewhere else. I cannot display this for you. ☹
+
+Info:
+MIME Type: %1
+File Size: %2
+)md").arg(mime).arg(IoUtil::size_human(data.size())));
+    }
+
+    return document;
+}
+
+void BrowserTab::on_requestComplete(const QByteArray &data, const QString &mime)
+{
+    qDebug() << "Loaded" << data.length() << "bytes of type" << mime;
+
+    RequestCoalescer::complete(this, data, mime);
+
+    // Pages that are rendered again (hibernation) or served from the cache
+    // don't take the network timing of the client
+    if(auto client_timing = this->clientTiming(); this->is_logging_request and not this->current_record.cache_hit and client_timing) {
+        this->timing.mergeNetwork(*client_timing);
+    }
+
+    // Reloaded pages rendered by Kristall replace only the blocks that changed,
+    // which keeps the scroll position and the selection
+    bool const is_patched = this->is_reloading
+        and not this->is_streaming_document
+        and mime == this->current_mime
+        and this->current_document != nullptr
+        and this->style_revision == StyleCache::revision()
+        and mime.startsWith("text/")
+        and not mime.startsWith("text/html")
+        and not mime.startsWith("text/markdown");
+    this->is_reloading = false;
+
+    this->current_mime = mime;
+    this->current_buffer = data;
+
+    // The beginning of the response is already shown
+    bool const is_streamed = this->is_streaming_document
+        and mime == this->streaming_mime
+        and this->current_document != nullptr
+        and data.size() >= this->streamed_bytes;
+
+    this->graphics_scene.clear();
+    if(not is_streamed and not is_patched) {
+        this->ui->text_browser->setText("");
+    }
+
+    ui->text_browser->setStyleSheet("");
+
+    enum DocumentType { Text, Image, Media };
+
+    DocumentType doc_type = Text;
+    std::unique_ptr<QTextDocument> document;
+
+    this->outline.clear();
+
+    auto const render_style = StyleCache::get(mainWindow->current_style, this->current_location);
+    auto const & doc_style = render_style->style;
+
+    this->ui->text_browser->setStyleSheet(QString("QTextBrowser { background-color: %1; }").arg(doc_style.background_color.name()));
+
+    if(is_streamed) {
+        this->appendStreamedData(data.mid(this->streamed_bytes));
+        document = std::move(this->current_document);
+        if(this->style_revision != StyleCache::revision()) {
+            render_style->restyle(*document);
+        }
     }
     else if(mime.startsWith("image/")) {
         doc_type = Image;
@@ -341,7 +694,14 @@ void BrowserTab::on_requestComplete(const QByteArray &data, const QString &mime)
 
 
         QImage img;
-        if(reader.read(&img))
+        bool image_ok;
+        {
+            TraceScope trace { "render", "QImageReader::read", this->tab_id };
+            StallScope stall { "QImageReader::read", this->current_location, data.size() };
+            image_ok = reader.read(&img);
+        }
+
+        if(image_ok)
         {
             auto pixmap = QPixmap::fromImage(img);
             this->graphics_scene.addPixmap(pixmap);
@@ -367,38 +727,71 @@ void BrowserTab::on_requestComplete(const QByteArray &data, const QString &mime)
         this->ui->media_browser->setMedia(data, this->current_location, mime);
     }
     else {
-        document = std::make_unique<QTextDocument>();
-        document->setDefaultFont(doc_style.standard_font);
-        document->setDefaultStyleSheet(doc_style.toStyleSheet());
-
-        document->setPlainText(QString(R"md(You accessed an unsupported media type!
-
-Use the *File* menu to save the file to your local disk or navigate somewhere else. I cannot display this for you. ☹
+        document = this->renderDocument(data, mime, *render_style);
+    }
 
-Info:
-MIME Type: %1
-File Size: %2
-)md").arg(mime).arg(IoUtil::size_human(data.size())));
+    if(is_patched and document != nullptr) {
+        StallScope stall { "DocumentPatch::apply", this->current_location, data.size() };
+        DocumentPatch::apply(*this->current_document, *document);
+        document = std::move(this->current_document);
     }
 
+    this->is_streaming_document = false;
+    this->gophermap_stream.reset();
+    this->style_revision = StyleCache::revision();
+
     assert((document != nullptr) == (doc_type == Text));
 
+    this->timing.mark(RequestTiming::Rendered);
+
     this->ui->text_browser->setVisible(doc_type == Text);
     this->ui->graphics_browser->setVisible(doc_type == Image);
     this->ui->media_browser->setVisible(doc_type == Media);
 
-    this->ui->text_browser->setDocument(document.get());
-    this->current_document = std::move(document);
+    {
+        TraceScope trace { "render", "QTextBrowser::setDocument", this->tab_id };
+        StallScope stall { "QTextBrowser::setDocument", this->current_location };
+        this->ui->text_browser->setDocument(document.get());
+        this->current_document = std::move(document);
+    }
+
+    this->timing.mark(RequestTiming::Displayed);
+
+    if(this->current_document != nullptr) {
+        TraceScope trace { "render", "QTextDocument layout", this->tab_id };
+        StallScope stall { "QTextDocument layout", this->current_location, data.size() };
+        // Querying the size finishes the layout of the document
+        this->current_document->size();
+        this->timing.mark(RequestTiming::LayoutDone);
+    }
 
     emit this->locationChanged(this->current_location);
 
     QString title = this->current_location.toString();
     emit this->titleChanged(title);
 
-    emit this->fileLoaded(data.size(), mime, this->timer.elapsed());
+    emit this->fileLoaded(data.size(), mime, int(this->timing.total() / 1000));
 
     this->successfully_loaded = true;
 
+    // Pages rendered again, served from the cache or by another tab don't
+    // start any background traffic
+    bool const is_network_load = this->is_logging_request and not this->current_record.cache_hit;
+
+    this->logRequest(mime, data.size(), QString { });
+
+    if(is_network_load and this->current_document != nullptr and global_settings.value("preconnect_page_hosts", false).toBool()) {
+        this->prefetchLinkedHosts();
+    }
+
+    if(is_network_load and this->current_document != nullptr and mime.startsWith("text/gemini") and global_settings.value("prefetch", false).toBool()) {
+        Prefetcher::prefetchLinks(this->current_location, documentLinks(*this->current_document, this->current_location));
+    }
+
+    Tracer::addTiming(this->timing, this->tab_id, this->current_location);
+
+    MemoryReport::sampleTabs(this->mainWindow->tabs());
+
     this->updateUI();
 }
 
@@ -409,6 +802,8 @@ void BrowserTab::on_protocolViolation(const QString &reason)
 
 void BrowserTab::on_inputRequired(const QString &query)
 {
+    this->logRequest(QString { }, 0, "Input required");
+
     QInputDialog dialog { this };
 
     dialog.setInputMode(QInputDialog::TextInput);
@@ -426,15 +821,32 @@ void BrowserTab::on_inputRequired(const QString &query)
 
 void BrowserTab::on_redirected(const QUrl &uri, bool is_permanent)
 {
+    // Waiting tabs follow the redirect on their own
+    RequestCoalescer::abandon(this);
+
     if(redirection_count >= 5) {
         setErrorMessage("Too many redirections!");
         return;
     }
     else {
-        if(gemini_client.startRequest(uri)) {
+        // Follow further hops we already know
+        QUrl const target = is_permanent ? global_redirect_cache.resolve(uri) : uri;
+
+        this->applyIdentity(target);
+
+        if(gemini_client->startRequest(target)) {
+            // Only redirects that are followed without asking are remembered
+            if(is_permanent and uri.scheme() == this->current_location.scheme()) {
+                global_redirect_cache.addRedirect(this->current_location, uri);
+                this->mainWindow->favourites.replace(this->current_location, uri);
+                if(this->history.get(this->current_history_index) == this->current_location) {
+                    this->history.replaceUrl(this->current_history_index, uri);
+                }
+            }
+            current_record.redirects.append(target);
             redirection_count += 1;
-            this->current_location = uri;
-            this->ui->url_bar->setText(uri.toString());
+            this->current_location = target;
+            this->ui->url_bar->setText(target.toString());
         }
     }
 }
@@ -463,6 +875,14 @@ void BrowserTab::on_temporaryFailure(TemporaryFailure reason, const QString &inf
 
 void BrowserTab::on_permanentFailure(PermanentFailure reason, const QString &info)
 {
+    if(this->current_location.scheme() == "gemini" and not this->current_record.cache_hit)
+    {
+        if(reason == PermanentFailure::not_found)
+            global_redirect_cache.addFailure(this->current_location, 51, info);
+        else if(reason == PermanentFailure::gone)
+            global_redirect_cache.addFailure(this->current_location, 52, info);
+    }
+
     switch(reason)
     {
     case PermanentFailure::gone:
@@ -485,9 +905,12 @@ void BrowserTab::on_permanentFailure(PermanentFailure reason, const QString &inf
 
 void BrowserTab::on_transientCertificateRequested(const QString &reason)
 {
+    this->logRequest(QString { }, 0, "Transient certificate requested");
+
     if(not trySetClientCertificate(reason)) {
         setErrorMessage(QString("The page requested a transient client certificate, but none was provided.\r\nOriginal query was: %1").arg(reason));
     } else {
+        this->addIdentityScope(this->current_location);
         this->navigateTo(this->current_location, DontPush);
     }
     this->updateUI();
@@ -495,9 +918,12 @@ void BrowserTab::on_transientCertificateRequested(const QString &reason)
 
 void BrowserTab::on_authorisedCertificateRequested(const QString &reason)
 {
+    this->logRequest(QString { }, 0, "Authorised certificate requested");
+
     if(not trySetClientCertificate(reason)) {
         setErrorMessage(QString("The page requested a authorized client certificate, but none was provided.\r\nOriginal query was: %1").arg(reason));
     } else {
+        this->addIdentityScope(this->current_location);
         this->navigateTo(this->current_location, DontPush);
     }
     this->updateUI();
@@ -505,6 +931,9 @@ void BrowserTab::on_authorisedCertificateRequested(const QString &reason)
 
 void BrowserTab::on_certificateRejected(CertificateRejection reason, const QString &info)
 {
+    // Don't send the rejected identity again without asking
+    this->removeIdentityScopes(this->current_location);
+
     switch(reason)
     {
     case CertificateRejection::unspecified:
@@ -527,8 +956,15 @@ void BrowserTab::on_linkHovered(const QString &url)
     this->mainWindow->setUrlPreview(QUrl(url));
 }
 
+void BrowserTab::on_hostCertificateMismatch(const QString &info)
+{
+    setErrorMessage(QString("The host presented a different certificate than on earlier visits. Someone may be intercepting the connection.\n\n%1\n\nIf the host changed its certificate on purpose, forget it on about:known-hosts and try again.").arg(info));
+}
+
 void BrowserTab::setErrorMessage(const QString &msg)
 {
+    this->logRequest(QString { }, 0, msg);
+
     this->on_requestComplete(
         QString("An error happened:\r\n%0").arg(msg).toUtf8(),
         "text/plain charset=utf-8"
@@ -585,6 +1021,13 @@ void BrowserTab::on_text_browser_highlighted(const QUrl &url)
         if(real_url.isRelative())
             real_url = this->current_location.resolved(url);
         this->mainWindow->setUrlPreview(real_url);
+
+        if(global_settings.value("prefetch", false).toBool() and Prefetcher::prefetch(real_url)) {
+            // The prefetch opens its own connection
+        }
+        else if(global_settings.value("preconnect", true).toBool()) {
+            Preconnector::preconnect(real_url);
+        }
     }
     else {
         this->mainWindow->setUrlPreview(QUrl { });
@@ -593,15 +1036,88 @@ void BrowserTab::on_text_browser_highlighted(const QUrl &url)
 
 void BrowserTab::on_stop_button_clicked()
 {
-    gemini_client.cancelRequest();
-    web_client.cancelRequest();
-    gopher_client.cancelRequest();
-    finger_client.cancelRequest();
+    this->logRequest(QString { }, 0, "Cancelled");
+
+    this->coalescing_key.clear();
+    RequestCoalescer::leave(this);
+
+    gemini_client->cancelRequest();
+    web_client->cancelRequest();
+    gopher_client->cancelRequest();
+    finger_client->cancelRequest();
+
+    this->resetClientReceiver();
+
+    this->is_streaming_document = false;
+    this->gophermap_stream.reset();
 }
 
 void BrowserTab::on_requestProgress(qint64 transferred)
 {
-    emit this->fileLoaded(transferred, "Loading...", timer.elapsed());
+    emit this->fileLoaded(transferred, "Loading...", int(this->timing.elapsed(RequestTiming::Navigate) / 1000));
+}
+
+void BrowserTab::on_requestData(const QByteArray &chunk, const QString &mime)
+{
+    // Only plain text and gopher menus can be shown in parts
+    bool plaintext_only = (global_settings.value("text_display").toString() == "plain");
+    bool const is_gophermap = not plaintext_only and mime.startsWith("text/gophermap");
+    if(not plaintext_only and not is_gophermap and not mime.startsWith("text/plain"))
+        return;
+
+    // Reloads keep showing the previous version until it can be patched
+    if(this->is_reloading)
+        return;
+
+    if(this->is_streaming_document and this->current_document != nullptr)
+    {
+        this->appendStreamedData(chunk);
+    }
+    else
+    {
+        auto const render_style = StyleCache::get(mainWindow->current_style, this->current_location);
+
+        std::unique_ptr<QTextDocument> document;
+        if(is_gophermap) {
+            StallScope stall { "GophermapRenderer::Stream::append", this->current_location, chunk.size() };
+            document = std::make_unique<QTextDocument>();
+            this->gophermap_stream = std::make_unique<GophermapRenderer::Stream>(*document, this->current_location, *render_style);
+            this->gophermap_stream->append(chunk);
+        }
+        else {
+            StallScope stall { "PlainTextRenderer::render", this->current_location, chunk.size() };
+            this->gophermap_stream.reset();
+            document = PlainTextRenderer::render(chunk, *render_style);
+        }
+
+        this->graphics_scene.clear();
+        this->outline.clear();
+        this->ui->text_browser->setStyleSheet(QString("QTextBrowser { background-color: %1; }").arg(render_style->style.background_color.name()));
+        this->ui->text_browser->setVisible(true);
+        this->ui->graphics_browser->setVisible(false);
+        this->ui->media_browser->setVisible(false);
+        this->ui->text_browser->setDocument(document.get());
+        this->current_document = std::move(document);
+
+        this->is_streaming_document = true;
+        this->streaming_mime = mime;
+        this->streamed_bytes = 0;
+        this->style_revision = StyleCache::revision();
+    }
+
+    this->streamed_bytes += chunk.size();
+}
+
+void BrowserTab::appendStreamedData(const QByteArray &data)
+{
+    if(this->gophermap_stream != nullptr) {
+        StallScope stall { "GophermapRenderer::Stream::append", this->current_location, data.size() };
+        this->gophermap_stream->append(data);
+    }
+    else {
+        StallScope stall { "PlainTextRenderer::append", this->current_location, data.size() };
+        PlainTextRenderer::append(*this->current_document, data, *StyleCache::get(mainWindow->current_style, this->current_location));
+    }
 }
 
 void BrowserTab::on_back_button_clicked()
@@ -633,7 +1149,8 @@ bool BrowserTab::trySetClientCertificate(const QString &query)
     dialog.setServerQuery(query);
 
     if(dialog.exec() != QDialog::Accepted) {
-        this->gemini_client.disableClientCertificate();
+        this->current_identitiy = CryptoIdentity { };
+        this->gemini_client->disableClientCertificate();
         this->ui->enable_client_cert_button->setChecked(false);
         return false;
     }
@@ -642,17 +1159,158 @@ bool BrowserTab::trySetClientCertificate(const QString &query)
 
     if(not current_identitiy.isValid()) {
         QMessageBox::warning(this, "Kristall", "Failed to generate temporary crypto-identitiy");
-        this->gemini_client.disableClientCertificate();
+        this->gemini_client->disableClientCertificate();
         this->ui->enable_client_cert_button->setChecked(false);
         return false;
     }
 
-    this->gemini_client.enableClientCertificate(this->current_identitiy);
+    this->gemini_client->enableClientCertificate(this->current_identitiy);
     this->ui->enable_client_cert_button->setChecked(true);
 
     return true;
 }
 
+QString BrowserTab::requestKey(const QUrl &url) const
+{
+    CryptoIdentity identity;
+    if(url.scheme() == "gemini") {
+        identity = this->identityFor(url);
+    }
+    return RequestCoalescer::key(url, identity);
+}
+
+void BrowserTab::on_coalescedResponse(const QString &key, const QByteArray &data, const QString &mime)
+{
+    if(key != this->coalescing_key)
+        return;
+    this->coalescing_key.clear();
+
+    this->current_record.cache_hit = true;
+    if(this->current_location.scheme() == "gemini")
+        this->current_record.status = "20";
+    this->on_requestComplete(data, mime);
+}
+
+void BrowserTab::on_coalescedRequestAbandoned(const QString &key)
+{
+    if(key != this->coalescing_key)
+        return;
+    this->coalescing_key.clear();
+
+    this->startNetworkRequest(this->current_location);
+}
+
+void BrowserTab::resetClientReceiver()
+{
+    if(this->client_receiver != nullptr)
+    {
+        // This may run in a slot that was called through the receiver, so it
+        // is only deleted later, but disconnected and emptied right away.
+        gemini_client->disconnect(this->client_receiver);
+        web_client->disconnect(this->client_receiver);
+        gopher_client->disconnect(this->client_receiver);
+        finger_client->disconnect(this->client_receiver);
+        QCoreApplication::removePostedEvents(this->client_receiver, QEvent::MetaCall);
+        this->client_receiver->deleteLater();
+    }
+    this->client_receiver = new QObject(this);
+
+    auto * receiver = this->client_receiver;
+
+    forwardSignal(web_client, &WebClient::requestComplete, receiver, this, &BrowserTab::on_requestComplete);
+    forwardSignal(web_client, &WebClient::requestFailed, receiver, this, &BrowserTab::on_requestFailed);
+    forwardSignal(web_client, &WebClient::requestProgress, receiver, this, &BrowserTab::on_requestProgress);
+
+    forwardSignal(gemini_client, &GeminiClient::requestComplete, receiver, this, &BrowserTab::on_requestComplete);
+    forwardSignal(gemini_client, &GeminiClient::requestProgress, receiver, this, &BrowserTab::on_requestProgress);
+    forwardSignal(gemini_client, &GeminiClient::protocolViolation, receiver, this, &BrowserTab::on_protocolViolation);
+    forwardSignal(gemini_client, &GeminiClient::inputRequired, receiver, this, &BrowserTab::on_inputRequired);
+    forwardSignal(gemini_client, &GeminiClient::redirected, receiver, this, &BrowserTab::on_redirected);
+    forwardSignal(gemini_client, &GeminiClient::temporaryFailure, receiver, this, &BrowserTab::on_temporaryFailure);
+    forwardSignal(gemini_client, &GeminiClient::permanentFailure, receiver, this, &BrowserTab::on_permanentFailure);
+    forwardSignal(gemini_client, &GeminiClient::transientCertificateRequested, receiver, this, &BrowserTab::on_transientCertificateRequested);
+    forwardSignal(gemini_client, &GeminiClient::authorisedCertificateRequested, receiver, this, &BrowserTab::on_authorisedCertificateRequested);
+    forwardSignal(gemini_client, &GeminiClient::certificateRejected, receiver, this, &BrowserTab::on_certificateRejected);
+    forwardSignal(gemini_client, &GeminiClient::hostCertificateMismatch, receiver, this, &BrowserTab::on_hostCertificateMismatch);
+    forwardSignal(gemini_client, &GeminiClient::requestFailed, receiver, this, &BrowserTab::on_requestFailed);
+
+    forwardSignal(gopher_client, &GopherClient::requestComplete, receiver, this, &BrowserTab::on_requestComplete);
+    forwardSignal(gopher_client, &GopherClient::requestFailed, receiver, this, &BrowserTab::on_requestFailed);
+    forwardSignal(gopher_client, &GopherClient::requestProgress, receiver, this, &BrowserTab::on_requestProgress);
+    forwardSignal(gopher_client, &GopherClient::requestData, receiver, this, &BrowserTab::on_requestData);
+
+    forwardSignal(finger_client, &FingerClient::requestComplete, receiver, this, &BrowserTab::on_requestComplete);
+    forwardSignal(finger_client, &FingerClient::requestFailed, receiver, this, &BrowserTab::on_requestFailed);
+    forwardSignal(finger_client, &FingerClient::requestProgress, receiver, this, &BrowserTab::on_requestProgress);
+}
+
+std::optional<RequestTiming> BrowserTab::clientTiming() const
+{
+    auto const scheme = this->current_location.scheme();
+    if(scheme == "gemini")
+        return this->gemini_client->timing();
+    if(scheme == "http" or scheme == "https")
+        return this->web_client->timing();
+    if(scheme == "gopher")
+        return this->gopher_client->timing();
+    if(scheme == "finger")
+        return this->finger_client->timing();
+    return std::nullopt;
+}
+
+QString BrowserTab::clientStatus() const
+{
+    int code = 0;
+    auto const scheme = this->current_location.scheme();
+    if(scheme == "gemini")
+        code = this->gemini_client->statusCode();
+    else if(scheme == "http" or scheme == "https")
+        code = this->web_client->statusCode();
+    return (code > 0) ? QString::number(code) : QString("-");
+}
+
+void BrowserTab::prefetchLinkedHosts()
+{
+    int const max_hosts = 8;
+
+    QSet<QString> hosts;
+    for(auto const & url : documentLinks(*this->current_document, this->current_location))
+    {
+        if(url.host().isEmpty() or url.host() == this->current_location.host() or hosts.contains(url.host()))
+            continue;
+        hosts.insert(url.host());
+        Preconnector::prefetchDns(url);
+        if(hosts.size() >= max_hosts)
+            break;
+    }
+}
+
+void BrowserTab::logRequest(const QString &mime, qint64 bytes, const QString &error)
+{
+    if(not this->is_logging_request)
+        return;
+    this->is_logging_request = false;
+
+    // The request ended without a response body
+    RequestCoalescer::abandon(this);
+    Prefetcher::endForeground();
+
+    if(not this->current_record.cache_hit)
+    {
+        if(auto client_timing = this->clientTiming(); client_timing) {
+            this->timing.mergeNetwork(*client_timing);
+        }
+        this->current_record.status = this->clientStatus();
+    }
+
+    this->current_record.mime = mime;
+    this->current_record.bytes = bytes;
+    this->current_record.error = error;
+    this->current_record.timing = this->timing;
+
+    global_request_log.add(this->current_record);
+}
+
 void BrowserTab::resetClientCertificate()
 {
     if(this->current_identitiy.isValid() and not this->current_identitiy.is_persistent)
@@ -664,10 +1322,85 @@ void BrowserTab::resetClientCertificate()
         }
     }
 
-    this->gemini_client.disableClientCertificate();
+    global_identities.removeScopes(this->current_identitiy);
+    for(int i = this->transient_scopes.size() - 1; i >= 0; i--)
+    {
+        if(this->transient_scopes[i].second.certificate == this->current_identitiy.certificate)
+            this->transient_scopes.removeAt(i);
+    }
+
+    this->is_identity_explicit = true;
+    this->current_identitiy = CryptoIdentity { };
+    this->gemini_client->disableClientCertificate();
     this->ui->enable_client_cert_button->setChecked(false);
 }
 
+CryptoIdentity BrowserTab::identityFor(const QUrl &url) const
+{
+    if(this->is_identity_explicit)
+        return this->current_identitiy;
+
+    // The most specific transient scope of this tab wins over shared scopes
+    auto const now = QDateTime::currentDateTime();
+    CryptoIdentity identity;
+    int best_length = -1;
+    for(auto const & scope : this->transient_scopes)
+    {
+        if(not IdentityCollection::isInScope(url, scope.first))
+            continue;
+        if(scope.second.certificate.expiryDate() < now)
+            continue;
+        if(scope.first.path().length() > best_length) {
+            identity = scope.second;
+            best_length = scope.first.path().length();
+        }
+    }
+    if(identity.isValid())
+        return identity;
+
+    return global_identities.findScopedIdentity(url);
+}
+
+void BrowserTab::applyIdentity(const QUrl &url)
+{
+    this->current_identitiy = this->identityFor(url);
+
+    if(this->current_identitiy.isValid())
+        this->gemini_client->enableClientCertificate(this->current_identitiy);
+    else
+        this->gemini_client->disableClientCertificate();
+    this->ui->enable_client_cert_button->setChecked(this->current_identitiy.isValid());
+}
+
+void BrowserTab::addIdentityScope(const QUrl &url)
+{
+    // The identity was given for this request, scopes apply again
+    this->is_identity_explicit = false;
+
+    if(this->current_identitiy.is_persistent) {
+        global_identities.addScope(url, this->current_identitiy);
+        return;
+    }
+
+    auto const scope = url.adjusted(QUrl::RemoveQuery | QUrl::RemoveFragment);
+    for(int i = this->transient_scopes.size() - 1; i >= 0; i--)
+    {
+        if(this->transient_scopes[i].first == scope)
+            this->transient_scopes.removeAt(i);
+    }
+    this->transient_scopes.append(qMakePair(scope, this->current_identitiy));
+}
+
+void BrowserTab::removeIdentityScopes(const QUrl &url)
+{
+    global_identities.removeScopes(url);
+    for(int i = this->transient_scopes.size() - 1; i >= 0; i--)
+    {
+        if(IdentityCollection::isInScope(url, this->transient_scopes[i].first))
+            this->transient_scopes.removeAt(i);
+    }
+}
+
 #include <QClipboard>
 
 void BrowserTab::on_text_browser_customContextMenuRequested(const QPoint &pos)
@@ -699,13 +1432,35 @@ void BrowserTab::on_text_browser_customContextMenuRequested(const QPoint &pos)
         this->ui->text_browser->selectAll();
     });
 
+    menu.addSeparator();
+
+    connect(menu.addAction("Auto-refresh…"), &QAction::triggered, [this]() {
+        bool ok = false;
+        int const seconds = QInputDialog::getInt(
+            this,
+            "Kristall",
+            "Reload this page every n seconds (0 disables it):",
+            this->auto_refresh_timer.isActive() ? this->auto_refresh_timer.interval() / 1000 : 0,
+            0,
+            24 * 60 * 60,
+            1,
+            &ok);
+        if(not ok)
+            return;
+        if(seconds > 0)
+            this->auto_refresh_timer.start(1000 * seconds);
+        else
+            this->auto_refresh_timer.stop();
+    });
+
     menu.exec(ui->text_browser->mapToGlobal(pos));
 }
 
 void BrowserTab::on_enable_client_cert_button_clicked(bool checked)
 {
     if(checked) {
-        trySetClientCertificate(QString{ });
+        if(trySetClientCertificate(QString{ }))
+            this->is_identity_explicit = true;
     } else {
         resetClientCertificate();
     }
@@ -2,16 +2,19 @@
 #define BROWSERTAB_HPP
 
 #include <memory>
+#include <optional>
 #include <QWidget>
 #include <QUrl>
 #include <QGraphicsScene>
 #include <QTextDocument>
 #include <QNetworkAccessManager>
-#include <QElapsedTimer>
+#include <QTimer>
 
 #include "documentoutlinemodel.hpp"
 #include "tabbrowsinghistory.hpp"
 #include "geminirenderer.hpp"
+#include "gophermaprenderer.hpp"
+#include "renderstyle.hpp"
 
 #include "geminiclient.hpp"
 #include "webclient.hpp"
@@ -19,6 +22,9 @@
 #include "fingerclient.hpp"
 
 #include "cryptoidentity.hpp"
+#include "requesttiming.hpp"
+#include "requestlog.hpp"
+#include "memoryreport.hpp"
 
 namespace Ui {
 class BrowserTab;
@@ -57,6 +63,27 @@ public:
 
     void focusUrlBar();
 
+    //! Estimates the memory held by this tab.
+    TabMemoryUsage memoryUsage() const;
+
+    //! Drops the rendered document and compresses the page data.
+    //! The page is rendered again by `wakeUp()` without refetching it.
+    void hibernate();
+
+    //! Restores a tab that was hibernated.
+    void wakeUp();
+
+    //! Applies a changed theme to the shown page without loading it again.
+    //! Documents rendered by Kristall only get new formats, others are
+    //! rendered again from the page data.
+    void restyle();
+
+    //! Another tab received the response this tab waits for.
+    void on_coalescedResponse(QString const & key, QByteArray const & data, QString const & mime);
+
+    //! The tab loading the page this tab waits for gave up, the request is sent by this tab.
+    void on_coalescedRequestAbandoned(QString const & key);
+
 signals:
     void titleChanged(QString const & title);
     void locationChanged(QUrl const & url);
@@ -87,6 +114,8 @@ private slots:
 
     void on_certificateRejected(CertificateRejection reason, QString const & info);
 
+    void on_hostCertificateMismatch(QString const & info);
+
     void on_linkHovered(const QString &url);
 
     void on_fav_button_clicked();
@@ -103,6 +132,9 @@ private slots:
 
     void on_requestProgress(qint64 transferred);
 
+    //! Shows text that arrived so far, before the request is complete.
+    void on_requestData(QByteArray const & chunk, QString const & mime);
+
     void on_text_browser_customContextMenuRequested(const QPoint &pos);
 
     void on_enable_client_cert_button_clicked(bool checked);
@@ -110,6 +142,21 @@ private slots:
 private:
     void setErrorMessage(QString const & msg);
 
+    //! Builds the text document for a response of type `mime`. Apart from
+    //! filling the outline of gemini pages this has no side effects, so
+    //! it is also used to restyle the current page.
+    std::unique_ptr<QTextDocument> renderDocument(QByteArray const & data, QString const & mime, RenderStyle const & render_style);
+
+    //! Renders more of the response shown by `on_requestData` into the current document.
+    void appendStreamedData(QByteArray const & data);
+
+    //! Serves `url` from the response cache, waits for another tab
+    //! loading `url` or sends the request with the matching client.
+    void startNetworkRequest(QUrl const & url);
+
+    //! Key under which concurrent requests for `url` are shared.
+    QString requestKey(QUrl const & url) const;
+
     void pushToHistory(QUrl const & url);
 
     void updateUI();
@@ -117,19 +164,55 @@ private:
     bool trySetClientCertificate(QString const & query);
 
     void resetClientCertificate();
+
+    //! Returns the identity this tab sends to `url`.
+    CryptoIdentity identityFor(QUrl const & url) const;
+
+    //! Makes the identity for `url` the current identity of the tab.
+    void applyIdentity(QUrl const & url);
+
+    //! Remembers to send the current identity to `url` and the paths below it.
+    void addIdentityScope(QUrl const & url);
+
+    //! Forgets the scopes that contain `url`.
+    void removeIdentityScopes(QUrl const & url);
+
+    //! Drops all client signals that are still queued for the previous
+    //! request and connects the clients to this tab again.
+    void resetClientReceiver();
+
+    //! Network timing of the client for the current location, if it has one.
+    std::optional<RequestTiming> clientTiming() const;
+
+    QString clientStatus() const;
+
+    //! Resolves the hosts of other capsules linked from the current document.
+    void prefetchLinkedHosts();
+
+    //! Adds the current request to the global request log, if it
+    //! is a network request and was not logged yet.
+    void logRequest(QString const & mime, qint64 bytes, QString const & error);
 public:
 
     Ui::BrowserTab *ui;
     MainWindow * mainWindow;
+    int const tab_id;
     QUrl current_location;
 
-    GeminiClient gemini_client;
-    WebClient web_client;
-    GopherClient gopher_client;
-    FingerClient finger_client;
+    //! The clients live on the network thread
+    GeminiClient * gemini_client;
+    WebClient * web_client;
+    GopherClient * gopher_client;
+    FingerClient * finger_client;
+    //! Receives the signals of the clients for the current request
+    QObject * client_receiver = nullptr;
     int redirection_count = 0;
 
     bool successfully_loaded = false;
+    //! Set while the shown page is loaded again
+    bool is_reloading = false;
+    //! Reloads the current page periodically, if enabled for this tab
+    QTimer auto_refresh_timer;
 
     DocumentOutlineModel outline;
     QGraphicsScene graphics_scene;
@@ -137,12 +220,34 @@ public:
     QModelIndex current_history_index;
 
     std::unique_ptr<QTextDocument> current_document;
+    //! StyleCache revision `current_document` was styled with
+    int style_revision = -1;
+    //! Set while `current_document` shows a response that is still being received
+    bool is_streaming_document = false;
+    QString streaming_mime;
+    qint64 streamed_bytes = 0;
+    //! Renders the gopher menu that is being received into `current_document`
+    std::unique_ptr<GophermapRenderer::Stream> gophermap_stream;
 
     QByteArray current_buffer;
     QString current_mime;
-    QElapsedTimer timer;
+    //! Phase timestamps of the current navigation
+    RequestTiming timing;
+
+    RequestRecord current_record;
+    bool is_logging_request = false;
+    //! Set while waiting for another tab to load the same page
+    QString coalescing_key;
+
+    bool is_hibernated = false;
+    QByteArray hibernated_buffer;
 
     CryptoIdentity current_identitiy;
+    //! Set when the user chose or disabled the identity with the certificate
+    //! button, which then takes priority over all scopes
+    bool is_identity_explicit = false;
+    //! Scopes of transient identities, which are only sent from this tab
+    QList<QPair<QUrl, CryptoIdentity>> transient_scopes;
 };
 
 #endif // BROWSERTAB_HPP
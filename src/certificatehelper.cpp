@@ -1,10 +1,63 @@
 #include "certificatehelper.hpp"
+#include "stalldetector.hpp"
+#include "kristall.hpp"
 
+#include <algorithm>
+#include <QList>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QtConcurrent>
+
+#include <openssl/evp.h>
+#include <openssl/ec.h>
 #include <openssl/rsa.h>
 #include <openssl/x509.h>
 #include <openssl/pem.h>
 
-CryptoIdentity CertificateHelper::createNewIdentity(const QString &common_name, QDateTime expiry_date)
+struct PooledKey
+{
+    CertificateHelper::KeyType type;
+    QByteArray pem;
+};
+
+//! Protects `key_pool` and `pending_keys`, which are filled by worker threads.
+static QMutex key_pool_mutex;
+static QList<PooledKey> key_pool;
+static int pending_keys = 0;
+
+static EVP_PKEY * generateKey(CertificateHelper::KeyType key_type)
+{
+    EVP_PKEY_CTX * ctx = EVP_PKEY_CTX_new_id((key_type == CertificateHelper::EcKey) ? EVP_PKEY_EC : EVP_PKEY_RSA, nullptr);
+    q_check_ptr(ctx);
+
+    if(EVP_PKEY_keygen_init(ctx) != 1)
+        qFatal("EVP_PKEY_keygen_init");
+
+    if(key_type == CertificateHelper::EcKey) {
+        EVP_PKEY_CTX_set_ec_paramgen_curve_nid(ctx, NID_X9_62_prime256v1);
+        EVP_PKEY_CTX_set_ec_param_enc(ctx, OPENSSL_EC_NAMED_CURVE);
+    } else {
+        EVP_PKEY_CTX_set_rsa_keygen_bits(ctx, 2048);
+    }
+
+    EVP_PKEY * pkey = nullptr;
+    if(EVP_PKEY_keygen(ctx, &pkey) != 1)
+        qFatal("EVP_PKEY_keygen");
+
+    EVP_PKEY_CTX_free(ctx);
+    return pkey;
+}
+
+static QByteArray readBio(BIO * bio)
+{
+    const char * buffer = nullptr;
+    size_t size = BIO_get_mem_data(bio, &buffer);
+    q_check_ptr(buffer);
+    return QByteArray(buffer, int(size));
+}
+
+//! Creates a self-signed certificate for `pkey`. Does not take ownership of `pkey`.
+static CryptoIdentity createIdentityFromKey(EVP_PKEY * pkey, CertificateHelper::KeyType key_type, const QString &common_name, QDateTime expiry_date)
 {
     CryptoIdentity identity;
 
@@ -16,11 +69,6 @@ CryptoIdentity CertificateHelper::createNewIdentity(const QString &common_name,
 
     QByteArray common_name_utf8 = common_name.toUtf8();
 
-    EVP_PKEY * pkey = EVP_PKEY_new();
-    q_check_ptr(pkey);
-    RSA * rsa = RSA_generate_key(2048, RSA_F4, nullptr, nullptr);
-    q_check_ptr(rsa);
-    EVP_PKEY_assign_RSA(pkey, rsa);
     X509 * x509 = X509_new();
     q_check_ptr(x509);
     ASN1_INTEGER_set(X509_get_serialNumber(x509), 1);
@@ -33,12 +81,11 @@ CryptoIdentity CertificateHelper::createNewIdentity(const QString &common_name,
     // X509_NAME_add_entry_by_txt(name, "O", MBSTRING_ASC, (unsigned char *)"My Organization", -1, -1, 0);
     X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, reinterpret_cast<unsigned char const *>(common_name_utf8.data()), common_name_utf8.size(), -1, 0);
     X509_set_issuer_name(x509, name);
-    X509_sign(x509, pkey, EVP_sha1());
+    X509_sign(x509, pkey, EVP_sha256());
     BIO * bp_private = BIO_new(BIO_s_mem());
     q_check_ptr(bp_private);
     if(PEM_write_bio_PrivateKey(bp_private, pkey, nullptr, nullptr, 0, nullptr, nullptr) != 1)
     {
-        EVP_PKEY_free(pkey);
         X509_free(x509);
         BIO_free_all(bp_private);
         qFatal("PEM_write_bio_PrivateKey");
@@ -47,33 +94,133 @@ CryptoIdentity CertificateHelper::createNewIdentity(const QString &common_name,
     q_check_ptr(bp_public);
     if(PEM_write_bio_X509(bp_public, x509) != 1)
     {
-        EVP_PKEY_free(pkey);
         X509_free(x509);
         BIO_free_all(bp_public);
         BIO_free_all(bp_private);
         qFatal("PEM_write_bio_PrivateKey");
     }
 
-    const char * buffer = nullptr;
-    size_t size = BIO_get_mem_data(bp_public, &buffer);
-    q_check_ptr(buffer);
-    identity.certificate = QSslCertificate(QByteArray(buffer, size));
+    identity.certificate = QSslCertificate(readBio(bp_public));
     if(identity.certificate.isNull())
     {
         qFatal("Failed to generate a random client certificate");
     }
-    size = BIO_get_mem_data(bp_private, &buffer);
-    q_check_ptr(buffer);
-    identity.private_key = QSslKey(QByteArray(buffer, size), QSsl::Rsa);
+    identity.private_key = QSslKey(readBio(bp_private), (key_type == CertificateHelper::EcKey) ? QSsl::Ec : QSsl::Rsa);
     if(identity.private_key.isNull())
     {
         qFatal("Failed to generate a random private key");
     }
 
-    EVP_PKEY_free(pkey); // this will also free the rsa key
     X509_free(x509);
     BIO_free_all(bp_public);
     BIO_free_all(bp_private);
 
     return identity;
 }
+
+CryptoIdentity CertificateHelper::createNewIdentity(const QString &common_name, QDateTime expiry_date, KeyType key_type)
+{
+    StallScope stall { "CertificateHelper::createNewIdentity" };
+
+    if(expiry_date < QDateTime::currentDateTime())
+        return CryptoIdentity { };
+
+    EVP_PKEY * pkey = generateKey(key_type);
+    auto identity = createIdentityFromKey(pkey, key_type, common_name, expiry_date);
+    EVP_PKEY_free(pkey);
+
+    return identity;
+}
+
+QFuture<CryptoIdentity> CertificateHelper::createNewIdentityAsync(const QString &common_name, QDateTime expiry_date, KeyType key_type)
+{
+    return QtConcurrent::run([common_name, expiry_date, key_type]() {
+        return createNewIdentity(common_name, expiry_date, key_type);
+    });
+}
+
+CryptoIdentity CertificateHelper::takeTransientIdentity(const QString &common_name, QDateTime expiry_date)
+{
+    auto const key_type = transientKeyType();
+
+    QByteArray pem;
+    {
+        QMutexLocker lock { &key_pool_mutex };
+        for(int i = 0; i < key_pool.size(); i++)
+        {
+            if(key_pool[i].type == key_type) {
+                pem = key_pool.takeAt(i).pem;
+                break;
+            }
+        }
+    }
+
+    fillTransientKeyPool();
+
+    if(pem.isEmpty())
+        return CryptoIdentity { };
+
+    BIO * bio = BIO_new_mem_buf(pem.constData(), pem.size());
+    q_check_ptr(bio);
+    EVP_PKEY * pkey = PEM_read_bio_PrivateKey(bio, nullptr, nullptr, nullptr);
+    BIO_free_all(bio);
+    if(pkey == nullptr)
+        return CryptoIdentity { };
+
+    auto identity = createIdentityFromKey(pkey, key_type, common_name, expiry_date);
+    EVP_PKEY_free(pkey);
+
+    return identity;
+}
+
+void CertificateHelper::fillTransientKeyPool()
+{
+    auto const key_type = transientKeyType();
+    int const pool_size = global_settings.value("transient_key_pool_size", 2).toInt();
+
+    int missing;
+    {
+        QMutexLocker lock { &key_pool_mutex };
+
+        // Keys of another type will never be handed out anymore
+        for(int i = key_pool.size() - 1; i >= 0; i--)
+        {
+            if(key_pool[i].type != key_type)
+                key_pool.removeAt(i);
+        }
+
+        missing = std::max(0, pool_size - key_pool.size() - pending_keys);
+        pending_keys += missing;
+    }
+
+    for(int i = 0; i < missing; i++)
+    {
+        QtConcurrent::run([key_type]() {
+            EVP_PKEY * pkey = generateKey(key_type);
+
+            BIO * bio = BIO_new(BIO_s_mem());
+            q_check_ptr(bio);
+            bool const ok = (PEM_write_bio_PrivateKey(bio, pkey, nullptr, nullptr, 0, nullptr, nullptr) == 1);
+            QByteArray const pem = ok ? readBio(bio) : QByteArray { };
+            BIO_free_all(bio);
+            EVP_PKEY_free(pkey);
+
+            QMutexLocker lock { &key_pool_mutex };
+            pending_keys -= 1;
+            if(ok)
+                key_pool.append(PooledKey { key_type, pem });
+        });
+    }
+}
+
+CertificateHelper::KeyType CertificateHelper::transientKeyType()
+{
+    return parseKeyType(global_settings.value("transient_key_type", "rsa").toString());
+}
+
+CertificateHelper::KeyType CertificateHelper::parseKeyType(const QString &name)
+{
+    if(name == "ec")
+        return EcKey;
+    return RsaKey;
+}
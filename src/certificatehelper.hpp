@@ -3,15 +3,43 @@
 
 #include "cryptoidentity.hpp"
 
+#include <QFuture>
+
 struct CertificateHelper
 {
     CertificateHelper() = delete;
 
-
+    enum KeyType {
+        RsaKey, //!< RSA with 2048 bit
+        EcKey,  //!< ECDSA on the NIST P-256 curve
+    };
 
     static CryptoIdentity createNewIdentity(
+            QString const & common_name,
+            QDateTime expiry_date,
+            KeyType key_type = RsaKey);
+
+    //! Runs createNewIdentity on a worker thread.
+    static QFuture<CryptoIdentity> createNewIdentityAsync(
+            QString const & common_name,
+            QDateTime expiry_date,
+            KeyType key_type = RsaKey);
+
+    //! Creates a transient identity from a pre-generated key without
+    //! blocking. Returns an invalid identity when no key is available.
+    //! The pool is refilled in the background.
+    static CryptoIdentity takeTransientIdentity(
             QString const & common_name,
             QDateTime expiry_date);
+
+    //! Starts generating keys in the background until the pool holds
+    //! "transient_key_pool_size" keys of the configured transient key type.
+    static void fillTransientKeyPool();
+
+    //! Key type used for transient identities ("transient_key_type" setting).
+    static KeyType transientKeyType();
+
+    static KeyType parseKeyType(QString const & name);
 };
 
 #endif // CERTIFICATEHELPER_HPP
@@ -8,6 +8,7 @@
 #include <random>
 #include <QDebug>
 #include <QItemSelectionModel>
+#include <QFutureWatcher>
 
 CertificateSelectionDialog::CertificateSelectionDialog(QWidget *parent) :
     QDialog(parent),
@@ -75,11 +76,28 @@ void CertificateSelectionDialog::acceptTemporaryWithTimeout(QDateTime timeout)
         c = distr(rng);
     }
 
-    this->cryto_identity = CertificateHelper::createNewIdentity(
-        QByteArray(items, sizeof items).toBase64(QByteArray::OmitTrailingEquals),
-        timeout);
+    auto const common_name = QString::fromUtf8(QByteArray(items, sizeof items).toBase64(QByteArray::OmitTrailingEquals));
 
-    this->accept();
+    this->cryto_identity = CertificateHelper::takeTransientIdentity(common_name, timeout);
+    if(this->cryto_identity.isValid()) {
+        this->accept();
+        return;
+    }
+
+    // No pre-generated key left, generate one without blocking the UI
+    this->setEnabled(false);
+    this->setCursor(Qt::BusyCursor);
+
+    auto * watcher = new QFutureWatcher<CryptoIdentity>(this);
+    connect(watcher, &QFutureWatcher<CryptoIdentity>::finished, this, [this, watcher]() {
+        this->cryto_identity = watcher->result();
+        watcher->deleteLater();
+
+        this->unsetCursor();
+        this->setEnabled(true);
+        this->accept();
+    });
+    watcher->setFuture(CertificateHelper::createNewIdentityAsync(common_name, timeout, CertificateHelper::transientKeyType()));
 }
 
 void CertificateSelectionDialog::on_currentChanged(const QModelIndex &current, const QModelIndex &previous)
@@ -96,7 +114,7 @@ void CertificateSelectionDialog::on_create_new_cert_clicked()
     if(dialog.exec() != QDialog::Accepted)
         return;
 
-    auto id = dialog.createIdentity();
+    auto id = dialog.identity();
     if(not id.isValid())
         return;
     id.is_persistent = true;
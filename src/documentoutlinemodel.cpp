@@ -4,9 +4,9 @@
 
 DocumentOutlineModel::DocumentOutlineModel() :
     QAbstractItemModel(),
-    root()
+    entries()
 {
-
+    this->entries.append(Entry { "<ROOT>", "", 0, -1, 0, QVector<int> { } });
 }
 
 void DocumentOutlineModel::clear()
@@ -19,62 +19,37 @@ void DocumentOutlineModel::clear()
 void DocumentOutlineModel::beginBuild()
 {
     beginResetModel();
-    root = Node {
-        nullptr,
-        "<ROOT>", "",
-        0, 0,
-        QList<Node> { },
-    };
+    this->entries.clear();
+    this->entries.append(Entry { "<ROOT>", "", 0, -1, 0, QVector<int> { } });
+    this->current_h1 = -1;
+    this->current_h2 = -1;
 }
 
 void DocumentOutlineModel::appendH1(const QString &title, QString const & anchor)
 {
-    root.children.append(Node {
-        &root,
-        title, anchor,
-        1, 0,
-        QList<Node> { },
-    });
+    this->current_h1 = append(0, 1, title, anchor);
+    this->current_h2 = -1;
 }
 
 void DocumentOutlineModel::appendH2(const QString &title, QString const & anchor)
 {
-    auto & parent = ensureLevel1();
-    parent.children.append(Node {
-        &parent,
-        title, anchor,
-        2, parent.children.size() - 1,
-        QList<Node> { },
-    });
+    this->current_h2 = append(ensureLevel1(), 2, title, anchor);
 }
 
 void DocumentOutlineModel::appendH3(const QString &title, QString const & anchor)
 {
-    auto & parent = ensureLevel2();
-    parent.children.append(Node {
-        &parent,
-        title, anchor,
-        3, parent.children.size() - 1,
-        QList<Node> { },
-    });
+    append(ensureLevel2(), 3, title, anchor);
 }
 
 void DocumentOutlineModel::endBuild()
 {
-    for(auto const & h1 : this->root.children)
+    this->entries.squeeze();
+    for(int i = 1; i < this->entries.size(); i++)
     {
-        assert(h1.depth == 1);
-        assert(h1.parent == &this->root);
-        for(auto const & h2 : h1.children)
-        {
-            assert(h2.depth == 2);
-            assert(h2.parent == &h1);
-            for(auto const & h3 : h2.children)
-            {
-                assert(h3.depth == 3);
-                assert(h3.parent == &h2);
-            }
-        }
+        auto const & entry = this->entries[i];
+        assert(entry.parent >= 0 and entry.parent < i);
+        assert(entry.depth == this->entries[entry.parent].depth + 1);
+        assert(this->entries[entry.parent].children[entry.row] == i);
     }
     endResetModel();
 }
@@ -84,9 +59,7 @@ QString DocumentOutlineModel::getTitle(const QModelIndex &index) const
     if(not index.isValid())
         return "";
 
-    Node const  *childItem = static_cast<Node const *>(index.internalPointer());
-
-    return childItem->title;
+    return entryAt(index).title;
 }
 
 QString DocumentOutlineModel::getAnchor(const QModelIndex &index) const
@@ -94,9 +67,17 @@ QString DocumentOutlineModel::getAnchor(const QModelIndex &index) const
     if(not index.isValid())
         return "";
 
-    Node const  *childItem = static_cast<Node const *>(index.internalPointer());
+    return entryAt(index).anchor;
+}
 
-    return childItem->anchor;
+qint64 DocumentOutlineModel::estimateMemoryUsage() const
+{
+    qint64 size = sizeof(Entry) * this->entries.capacity();
+    for(auto const & entry : this->entries) {
+        size += sizeof(QChar) * (entry.title.capacity() + entry.anchor.capacity());
+        size += sizeof(int) * entry.children.capacity();
+    }
+    return size;
 }
 
 QModelIndex DocumentOutlineModel::index(int row, int column, const QModelIndex &parent) const
@@ -104,17 +85,9 @@ QModelIndex DocumentOutlineModel::index(int row, int column, const QModelIndex &
     if (not hasIndex(row, column, parent))
         return QModelIndex();
 
-    Node const * parentItem;
-
-    if (!parent.isValid())
-        parentItem = &this->root;
-    else
-        parentItem = static_cast<Node*>(parent.internalPointer());
+    int const parent_pos = parent.isValid() ? int(parent.internalId()) : 0;
 
-    Node const * childItem = &parentItem->children[row];
-    if (childItem)
-        return createIndex(row, column, reinterpret_cast<quintptr>(childItem));
-    return QModelIndex();
+    return createIndex(row, column, quintptr(this->entries[parent_pos].children[row]));
 }
 
 QModelIndex DocumentOutlineModel::parent(const QModelIndex &child) const
@@ -122,30 +95,25 @@ QModelIndex DocumentOutlineModel::parent(const QModelIndex &child) const
     if (!child.isValid())
         return QModelIndex();
 
-    Node const  *childItem = static_cast<Node const *>(child.internalPointer());
-    Node const * parent = childItem->parent;
-
-    if (parent == &root)
+    int const parent_pos = entryAt(child).parent;
+    if (parent_pos <= 0)
         return QModelIndex();
 
     return createIndex(
-        parent->index,
+        this->entries[parent_pos].row,
         0,
-        reinterpret_cast<quintptr>(parent));
+        quintptr(parent_pos));
 }
 
 int DocumentOutlineModel::rowCount(const QModelIndex &parent) const
 {
-    Node const * parentItem;
     if (parent.column() > 0)
         return 0;
 
     if (!parent.isValid())
-        parentItem = &root;
-    else
-        parentItem = static_cast<Node const *>(parent.internalPointer());
+        return this->entries[0].children.size();
 
-    return parentItem->children.size();
+    return entryAt(parent).children.size();
 }
 
 int DocumentOutlineModel::columnCount(const QModelIndex &parent) const
@@ -165,36 +133,37 @@ QVariant DocumentOutlineModel::data(const QModelIndex &index, int role) const
     if (role != Qt::DisplayRole)
         return QVariant();
 
-    Node const *item = static_cast<Node const*>(index.internalPointer());
+    return entryAt(index).title;
+}
 
-    return item->title;
+int DocumentOutlineModel::append(int parent, int depth, const QString &title, const QString &anchor)
+{
+    int const pos = this->entries.size();
+    int const row = this->entries[parent].children.size();
+    this->entries.append(Entry { title, anchor, depth, parent, row, QVector<int> { } });
+    this->entries[parent].children.append(pos);
+    return pos;
 }
 
-DocumentOutlineModel::Node & DocumentOutlineModel::ensureLevel1()
+DocumentOutlineModel::Entry const & DocumentOutlineModel::entryAt(const QModelIndex &index) const
 {
-    if(root.children.size() == 0) {
-        root.children.append(Node {
-            &root,
-            "<missing layer>", "",
-            1, 0,
-            QList<Node> { },
-        });
+    return this->entries[int(index.internalId())];
+}
+
+int DocumentOutlineModel::ensureLevel1()
+{
+    if(this->current_h1 < 0) {
+        this->current_h1 = append(0, 1, "<missing layer>", "");
     }
-    return root.children.last();
+    return this->current_h1;
 }
 
-DocumentOutlineModel::Node & DocumentOutlineModel::ensureLevel2()
+int DocumentOutlineModel::ensureLevel2()
 {
-    auto & parent = ensureLevel1();
+    int const parent = ensureLevel1();
 
-    if(parent.children.size() == 0) {
-        parent.children.append(Node {
-            &parent,
-            "<missing layer>", "",
-            2, 0,
-            QList<Node> { },
-        });
+    if(this->current_h2 < 0) {
+        this->current_h2 = append(parent, 2, "<missing layer>", "");
     }
-
-    return parent.children.last();
+    return this->current_h2;
 }
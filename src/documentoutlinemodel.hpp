@@ -2,7 +2,7 @@
 #define DOCUMENTOUTLINEMODEL_HPP
 
 #include <QAbstractItemModel>
-#include <QList>
+#include <QVector>
 
 class DocumentOutlineModel :
     public QAbstractItemModel
@@ -26,6 +26,9 @@ public:
     QString getTitle(QModelIndex const & index) const;
     QString getAnchor(QModelIndex const & index) const;
 
+    //! Rough estimate of the memory used by the outline in bytes.
+    qint64 estimateMemoryUsage() const;
+
 public:
     QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const override;
 
@@ -38,20 +41,34 @@ public:
 
 
 private:
-    struct Node
+    //! A heading in the outline. Entries refer to each other by their
+    //! position in `entries`, so they stay valid when the array grows.
+    struct Entry
     {
-        Node * parent;
         QString title;
         QString anchor;
         int depth = 0;
-        int index = 0;
-        QList<Node> children;
+        //! Position of the parent entry
+        int parent = -1;
+        //! Row of the entry below its parent
+        int row = 0;
+        //! Positions of the child entries
+        QVector<int> children;
     };
 
-    Node root;
+    //! All headings in document order, the first entry is the root
+    QVector<Entry> entries;
+    //! The last heading of level 1 and 2 or -1
+    int current_h1 = -1;
+    int current_h2 = -1;
+
+    //! Appends a heading below `parent` and returns its position
+    int append(int parent, int depth, QString const & title, QString const & anchor);
+
+    Entry const & entryAt(QModelIndex const & index) const;
 
-    Node & ensureLevel1();
-    Node & ensureLevel2();
+    int ensureLevel1();
+    int ensureLevel2();
 };
 
 #endif // DOCUMENTOUTLINEMODEL_HPP
@@ -0,0 +1,118 @@
+#include "documentpatch.hpp"
+#include "tracer.hpp"
+
+#include <QVector>
+#include <QTextBlock>
+#include <QTextCursor>
+#include <QTextDocumentFragment>
+#include <QHash>
+
+//! Hashes the text and the formats of `block`
+static uint blockHash(QTextBlock const & block)
+{
+    uint hash = qHash(block.text());
+    hash = hash * 31 + qHash(block.blockFormat().properties().size());
+    for(auto it = block.begin(); not it.atEnd(); ++it)
+    {
+        auto const fragment = it.fragment();
+        hash = hash * 31 + uint(fragment.length());
+        hash = hash * 31 + qHash(fragment.charFormat().anchorHref());
+        hash = hash * 31 + uint(fragment.charFormat().properties().size());
+    }
+    return hash;
+}
+
+static bool blocksEqual(QTextBlock const & a, uint hash_a, QTextBlock const & b, uint hash_b)
+{
+    if(hash_a != hash_b)
+        return false;
+    if(a.text() != b.text() or a.blockFormat() != b.blockFormat())
+        return false;
+
+    auto it_a = a.begin();
+    auto it_b = b.begin();
+    for(; not it_a.atEnd() and not it_b.atEnd(); ++it_a, ++it_b)
+    {
+        if(it_a.fragment().length() != it_b.fragment().length())
+            return false;
+        if(it_a.fragment().charFormat() != it_b.fragment().charFormat())
+            return false;
+    }
+    return it_a.atEnd() and it_b.atEnd();
+}
+
+static QVector<QTextBlock> blocksOf(QTextDocument const & document, QVector<uint> & hashes)
+{
+    QVector<QTextBlock> blocks;
+    blocks.reserve(document.blockCount());
+    hashes.reserve(document.blockCount());
+    for(QTextBlock block = document.begin(); block.isValid(); block = block.next())
+    {
+        blocks.append(block);
+        hashes.append(blockHash(block));
+    }
+    return blocks;
+}
+
+int DocumentPatch::apply(QTextDocument &target, const QTextDocument &source)
+{
+    TraceScope trace { "render", "DocumentPatch::apply" };
+
+    QVector<uint> old_hashes, new_hashes;
+    auto const old_blocks = blocksOf(target, old_hashes);
+    auto const new_blocks = blocksOf(source, new_hashes);
+
+    int const old_count = old_blocks.size();
+    int const new_count = new_blocks.size();
+    int const shorter = qMin(old_count, new_count);
+
+    // Unchanged blocks at the start and at the end
+    int prefix = 0;
+    while(prefix < shorter and blocksEqual(old_blocks[prefix], old_hashes[prefix], new_blocks[prefix], new_hashes[prefix]))
+        prefix += 1;
+
+    if(prefix == old_count and prefix == new_count)
+        return 0;
+
+    // Both documents always keep at least one block in the changed range,
+    // so the ranges below start at an existing block
+    prefix = qMin(prefix, shorter - 1);
+
+    int suffix = 0;
+    while(suffix < shorter - prefix - 1
+          and blocksEqual(old_blocks[old_count - 1 - suffix], old_hashes[old_count - 1 - suffix],
+                          new_blocks[new_count - 1 - suffix], new_hashes[new_count - 1 - suffix]))
+        suffix += 1;
+
+    auto const rangeEnd = [](QTextDocument const & document, QVector<QTextBlock> const & blocks, int suffix) {
+        return (suffix > 0) ? blocks[blocks.size() - suffix].position() : document.characterCount() - 1;
+    };
+
+    QTextCursor source_cursor { const_cast<QTextDocument*>(&source) };
+    source_cursor.setPosition(new_blocks[prefix].position());
+    source_cursor.setPosition(rangeEnd(source, new_blocks, suffix), QTextCursor::KeepAnchor);
+    QTextDocumentFragment const replacement { source_cursor };
+
+    QTextCursor cursor { &target };
+    cursor.beginEditBlock();
+
+    cursor.setPosition(old_blocks[prefix].position());
+    cursor.setPosition(rangeEnd(target, old_blocks, suffix), QTextCursor::KeepAnchor);
+    cursor.removeSelectedText();
+    if(not replacement.isEmpty())
+        cursor.insertFragment(replacement);
+
+    // Inserting a fragment doesn't always take over the format of its first block
+    QTextBlock block = target.findBlockByNumber(prefix);
+    for(int i = prefix; i < new_count - suffix and block.isValid(); i++, block = block.next())
+    {
+        if(block.blockFormat() != new_blocks[i].blockFormat()) {
+            QTextCursor block_cursor { block };
+            block_cursor.setBlockFormat(new_blocks[i].blockFormat());
+        }
+    }
+
+    cursor.endEditBlock();
+
+    return new_count - suffix - prefix;
+}
@@ -0,0 +1,19 @@
+#ifndef DOCUMENTPATCH_HPP
+#define DOCUMENTPATCH_HPP
+
+#include <QTextDocument>
+
+//! Updates a shown document to a newly rendered version of the same page
+//! by replacing only the blocks that changed. Cursors, the selection and
+//! the layout of unchanged blocks are kept.
+struct DocumentPatch
+{
+    DocumentPatch() = delete;
+
+    //! Makes `target` equal to `source`. Blocks are compared by a hash of
+    //! their text and formats; the blocks between the first and the last
+    //! differing block are replaced. Returns the number of replaced blocks.
+    static int apply(QTextDocument & target, QTextDocument const & source);
+};
+
+#endif // DOCUMENTPATCH_HPP
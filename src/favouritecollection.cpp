@@ -31,6 +31,24 @@ void FavouriteCollection::remove(QUrl const & url)
     }
 }
 
+void FavouriteCollection::replace(const QUrl &from, const QUrl &to)
+{
+    if(contains(to)) {
+        remove(from);
+        return;
+    }
+
+    for(int i = 0; i < items.size(); i++)
+    {
+        if(items.at(i) == from) {
+            items[i] = to;
+            auto const index = createIndex(i, 0);
+            emit dataChanged(index, index);
+            return;
+        }
+    }
+}
+
 bool FavouriteCollection::contains(const QUrl &url)
 {
     for(auto const & item : items) {
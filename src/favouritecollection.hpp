@@ -17,6 +17,9 @@ public:
 
     void remove(QUrl const & url);
 
+    //! Replaces `from` with `to` at the same position, used when a favourite moved permanently.
+    void replace(QUrl const & from, QUrl const & to);
+
     bool contains(QUrl const & url);
 
     QUrl get(QModelIndex const & index) const ;
@@ -1,11 +1,20 @@
 #include "fingerclient.hpp"
 #include "ioutil.hpp"
+#include "networkthread.hpp"
 
-FingerClient::FingerClient(QObject *parent) : QObject(parent)
+FingerClient::FingerClient(QObject *parent) :
+    QObject(parent),
+    connector(this),
+    timeout(this)
 {
-    connect(&socket, &QTcpSocket::connected, this, &FingerClient::on_connected);
-    connect(&socket, &QTcpSocket::readyRead, this, &FingerClient::on_readRead);
-    connect(&socket, &QTcpSocket::disconnected, this, &FingerClient::on_finished);
+    connect(&connector, &HostConnector::hostFound, this, &FingerClient::on_hostFound);
+    connect(&connector, &HostConnector::connected, this, &FingerClient::on_hostConnected);
+    connect(&connector, &HostConnector::failed, this, [this](QString const & message) {
+        was_cancelled = true;
+        emit this->requestFailed(message);
+    });
+
+    connect(&timeout, &RequestTimeout::expired, this, &FingerClient::on_timeout);
 }
 
 FingerClient::~FingerClient()
@@ -15,51 +24,106 @@ FingerClient::~FingerClient()
 
 bool FingerClient::startRequest(const QUrl &url)
 {
-    if(isInProgress())
-        return false;
-
     if(url.scheme() != "finger")
         return false;
 
-    this->requested_user = url.userName();
-    this->was_cancelled = false;
-    socket.connectToHost(url.host(), url.port(79));
+    QMetaObject::invokeMethod(this, [this, url]() {
+        this->beginRequest(url);
+    }, Qt::QueuedConnection);
 
     return true;
 }
 
 bool FingerClient::isInProgress() const
 {
-    return socket.isOpen();
+    return (socket != nullptr and socket->isOpen()) or connector.isConnecting();
 }
 
 bool FingerClient::cancelRequest()
 {
+    NetworkThread::invokeBlocking(this, [this]() {
+        this->abortRequest();
+    });
+
+    return true;
+}
+
+void FingerClient::beginRequest(const QUrl &url)
+{
+    if(isInProgress())
+        this->abortRequest();
+
+    this->requested_user = url.userName();
+    this->was_cancelled = false;
+    this->request_timing.start();
+    connector.connectToHost(url.host(), quint16(url.port(79)), []() {
+        return new QTcpSocket();
+    });
+}
+
+void FingerClient::abortRequest()
+{
+    connector.abort();
+    timeout.stop();
     was_cancelled = true;
-    socket.close();
+    if(socket != nullptr)
+        socket->close();
     body.clear();
-    return true;
+}
+
+void FingerClient::on_hostFound()
+{
+    this->request_timing.mark(RequestTiming::HostLookup);
+}
+
+void FingerClient::on_hostConnected(QTcpSocket *socket)
+{
+    HostConnector::replaceSocket(this, this->socket, socket);
+
+    connect(socket, &QTcpSocket::readyRead, this, &FingerClient::on_readRead);
+    connect(socket, &QTcpSocket::disconnected, this, &FingerClient::on_finished);
+
+    this->on_connected();
 }
 
 void FingerClient::on_connected()
 {
+    this->request_timing.mark(RequestTiming::Connected);
+
     auto blob = (requested_user + "\r\n").toUtf8();
 
-    IoUtil::writeAll(socket, blob);
+    IoUtil::writeAll(*socket, blob);
+
+    this->request_timing.mark(RequestTiming::RequestSent);
+
+    timeout.arm(NetworkTimeouts::firstByte(), "The host did not respond in time");
 }
 
 void FingerClient::on_readRead()
 {
-    body.append(socket.readAll());
+    this->request_timing.markOnce(RequestTiming::FirstByte);
+
+    timeout.arm(NetworkTimeouts::idle(), "The connection stalled");
+
+    body.append(socket->readAll());
     emit this->requestProgress(body.size());
 }
 
 void FingerClient::on_finished()
 {
+    timeout.stop();
+
     if(not was_cancelled)
     {
+        this->request_timing.mark(RequestTiming::Transferred);
         emit this->requestComplete(this->body, "text/finger");
         was_cancelled = true;
     }
     body.clear();
 }
+
+void FingerClient::on_timeout(const QString &message)
+{
+    this->abortRequest();
+    emit this->requestFailed(message);
+}
@@ -5,6 +5,9 @@
 #include <QTcpSocket>
 #include <QUrl>
 
+#include "requesttiming.hpp"
+#include "hostconnector.hpp"
+
 class FingerClient : public QObject
 {
     Q_OBJECT
@@ -13,12 +16,22 @@ public:
 
     ~FingerClient() override;
 
+    //! Starts the request on the thread of the client. Returns false if
+    //! `url` can't be handled by this client.
     bool startRequest(QUrl const & url);
 
+    //! Must be called on the thread of the client.
     bool isInProgress() const;
 
+    //! Cancels the current request and waits for the thread of the client to
+    //! do so. Signals that were queued before are still delivered.
     bool cancelRequest();
 
+    //! Phase timestamps of the current or last request
+    RequestTiming timing() const {
+        return request_timing.get();
+    }
+
 signals:
     void requestProgress(qint64 transferred);
 
@@ -27,14 +40,25 @@ signals:
     void requestFailed(QString const & message);
 
 private slots:
+    void on_hostFound();
+    void on_hostConnected(QTcpSocket * socket);
     void on_connected();
     void on_readRead();
     void on_finished();
+    void on_timeout(QString const & message);
+
+private:
+    void beginRequest(QUrl const & url);
+
+    void abortRequest();
 
 private:
-    QTcpSocket socket;
+    QTcpSocket * socket = nullptr;
+    HostConnector connector;
+    RequestTimeout timeout;
     QByteArray body;
     bool was_cancelled;
+    SharedRequestTiming request_timing;
     QString requested_user;
 };
 
@@ -1,23 +1,26 @@
 #include "geminiclient.hpp"
+#include "kristall.hpp"
+#include "preconnector.hpp"
+#include "networkthread.hpp"
 #include <cassert>
 #include <QDebug>
 #include <QSslConfiguration>
+#include <QCryptographicHash>
 
-GeminiClient::GeminiClient(QObject *parent) : QObject(parent)
+GeminiClient::GeminiClient(QObject *parent) :
+    QObject(parent),
+    connector(this),
+    timeout(this)
 {
-    connect(&socket, &QSslSocket::encrypted, this, &GeminiClient::socketEncrypted);
-    connect(&socket, &QSslSocket::readyRead, this, &GeminiClient::socketReadyRead);
-    connect(&socket, &QSslSocket::disconnected, this, &GeminiClient::socketDisconnected);
-    connect(&socket, QOverload<const QList<QSslError> &>::of(&QSslSocket::sslErrors), this, &GeminiClient::sslErrors);
-    connect(&socket, QOverload<QAbstractSocket::SocketError>::of(&QSslSocket::error), this, &GeminiClient::socketError);
+    auto * socket = new QSslSocket(this);
+    socket->setSslConfiguration(sslConfiguration());
+    this->setSocket(socket);
 
+    connect(&connector, &HostConnector::hostFound, this, &GeminiClient::socketHostFound);
+    connect(&connector, &HostConnector::connected, this, &GeminiClient::hostConnected);
+    connect(&connector, &HostConnector::failed, this, &GeminiClient::requestFailed);
 
-    QSslConfiguration ssl_config;
-    ssl_config.setProtocol(QSsl::TlsV1_2);
-    // ssl_config.setLocalCertificate(QSslCertificate::1
-
-    socket.setSslConfiguration(ssl_config);
-
+    connect(&timeout, &RequestTimeout::expired, this, &GeminiClient::requestTimedOut);
 }
 
 GeminiClient::~GeminiClient()
@@ -25,76 +28,214 @@ GeminiClient::~GeminiClient()
     is_receiving_body = false;
 }
 
+QSslConfiguration GeminiClient::sslConfiguration()
+{
+    QSslConfiguration ssl_config;
+    ssl_config.setProtocol(QSsl::TlsV1_2);
+    // Gemini hosts use self-signed certificates, which are pinned in
+    // global_known_hosts instead of validated against the system CAs.
+    ssl_config.setPeerVerifyMode(QSslSocket::VerifyNone);
+    // An explicit, empty CA list also disables on-demand loading of the system CAs
+    ssl_config.setCaCertificates(QList<QSslCertificate> { });
+    return ssl_config;
+}
+
 bool GeminiClient::startRequest(const QUrl &url)
 {
     if(url.scheme() != "gemini")
         return false;
 
-    if(socket.isOpen())
-        return false;
+    auto const identity = this->client_identity;
+
+    // Preconnected sockets did their handshake without a client certificate
+    QSslSocket * warm_socket = identity.isValid() ? nullptr : Preconnector::take(url);
+
+    QMetaObject::invokeMethod(this, [this, url, identity, warm_socket]() {
+        this->beginRequest(url, identity, warm_socket);
+    }, Qt::QueuedConnection);
 
-    socket.connectToHostEncrypted(url.host(), url.port(1965));
+    return true;
+}
+
+bool GeminiClient::isInProgress() const
+{
+    return socket->isOpen() or connector.isConnecting();
+}
+
+bool GeminiClient::cancelRequest()
+{
+    NetworkThread::invokeBlocking(this, [this]() {
+        this->abortRequest();
+    });
+    return true;
+}
+
+void GeminiClient::beginRequest(const QUrl &url, const CryptoIdentity &identity, QSslSocket *warm_socket)
+{
+    if(isInProgress())
+        this->abortRequest();
+
+    request_timing.start();
+    status_code = 0;
 
     buffer.clear();
     body.clear();
     is_receiving_body = false;
+    is_awaiting_header = true;
 
-    if(not socket.isOpen())
-        return false;
+    // The host may have closed the connection since it was handed over
+    if(warm_socket != nullptr and warm_socket->state() == QAbstractSocket::UnconnectedState) {
+        warm_socket->deleteLater();
+        warm_socket = nullptr;
+    }
+
+    if(warm_socket != nullptr)
+    {
+        this->setSocket(warm_socket);
+
+        if(warm_socket->state() != QAbstractSocket::HostLookupState)
+            request_timing.mark(RequestTiming::HostLookup);
+        if(warm_socket->state() == QAbstractSocket::ConnectedState)
+            request_timing.mark(RequestTiming::Connected);
+
+        target_url = url;
+        mime_type = "<invalid>";
+
+        if(warm_socket->isEncrypted()) {
+            // Send the request after the caller finished setting up, as it would
+            // happen with a new connection
+            QMetaObject::invokeMethod(this, "socketEncrypted", Qt::QueuedConnection);
+        } else {
+            timeout.arm(NetworkTimeouts::handshake(), "TLS handshake timed out");
+        }
+        return;
+    }
 
     target_url = url;
     mime_type = "<invalid>";
 
-    return true;
-}
-
-bool GeminiClient::isInProgress() const
-{
-    return socket.isOpen();
+    connector.connectToHost(url.host(), quint16(url.port(1965)), [identity]() -> QTcpSocket * {
+        auto * socket = new QSslSocket();
+        socket->setSslConfiguration(sslConfiguration());
+        socket->setLocalCertificate(identity.certificate);
+        socket->setPrivateKey(identity.private_key);
+        return socket;
+    });
 }
 
-bool GeminiClient::cancelRequest()
+void GeminiClient::abortRequest()
 {
+    this->connector.abort();
+    this->timeout.stop();
     this->is_receiving_body = false;
-    this->socket.close();
+    this->is_awaiting_header = false;
+    this->socket->close();
     this->buffer.clear();
     this->body.clear();
-    return true;
 }
 
 void GeminiClient::enableClientCertificate(const CryptoIdentity &ident)
 {
-    this->socket.setLocalCertificate(ident.certificate);
-    this->socket.setPrivateKey(ident.private_key);
+    this->client_identity = ident;
 }
 
 void GeminiClient::disableClientCertificate()
 {
-    this->socket.setLocalCertificate(QSslCertificate{});
-    this->socket.setPrivateKey(QSslKey { });
+    this->client_identity = CryptoIdentity { };
+}
+
+void GeminiClient::setSocket(QSslSocket *socket)
+{
+    HostConnector::replaceSocket(this, this->socket, socket);
+
+    connect(socket, &QSslSocket::hostFound, this, &GeminiClient::socketHostFound);
+    connect(socket, &QSslSocket::connected, this, &GeminiClient::socketConnected);
+    connect(socket, &QSslSocket::encrypted, this, &GeminiClient::socketEncrypted);
+    connect(socket, &QSslSocket::readyRead, this, &GeminiClient::socketReadyRead);
+    connect(socket, &QSslSocket::disconnected, this, &GeminiClient::socketDisconnected);
+    connect(socket, QOverload<const QList<QSslError> &>::of(&QSslSocket::sslErrors), this, &GeminiClient::sslErrors);
+    connect(socket, QOverload<QAbstractSocket::SocketError>::of(&QSslSocket::error), this, &GeminiClient::socketError);
+}
+
+void GeminiClient::socketHostFound()
+{
+    request_timing.mark(RequestTiming::HostLookup);
+}
+
+void GeminiClient::hostConnected(QTcpSocket *socket)
+{
+    auto * ssl_socket = static_cast<QSslSocket*>(socket);
+    this->setSocket(ssl_socket);
+    this->socketConnected();
+
+    timeout.arm(NetworkTimeouts::handshake(), "TLS handshake timed out");
+
+    // The socket is connected to an address, so the host name is passed for SNI
+    ssl_socket->setPeerVerifyName(target_url.host());
+    ssl_socket->startClientEncryption();
+}
+
+void GeminiClient::requestTimedOut(const QString &message)
+{
+    failRequest(message);
+}
+
+void GeminiClient::failRequest(const QString &message)
+{
+    this->abortRequest();
+    emit requestFailed(message);
+}
+
+void GeminiClient::socketConnected()
+{
+    request_timing.mark(RequestTiming::Connected);
 }
 
 void GeminiClient::socketEncrypted()
 {
+    request_timing.mark(RequestTiming::Handshake);
+
+    auto const certificate = socket->peerCertificate();
+    auto const pinned = global_known_hosts.entry(target_url.host(), target_url.port(1965));
+    if(global_known_hosts.verify(target_url.host(), target_url.port(1965), certificate) == KnownHosts::Mismatch)
+    {
+        is_awaiting_header = false;
+        socket->close();
+        emit hostCertificateMismatch(QString("Host: %1\nExpected SHA-256: %2\nReceived SHA-256: %3\nThe expected certificate is valid until %4.")
+            .arg(target_url.host())
+            .arg(KnownHosts::fingerprintString(pinned.fingerprint))
+            .arg(KnownHosts::fingerprintString(certificate.digest(QCryptographicHash::Sha256)))
+            .arg(pinned.expiry.toLocalTime().toString(Qt::ISODate)));
+        return;
+    }
+
     QString request = target_url.toString(QUrl::FormattingOptions(QUrl::FullyEncoded)) + "\r\n";
 
     QByteArray request_bytes = request.toUtf8();
 
     qint64 offset = 0;
     while(offset < request_bytes.size()) {
-        auto const len = socket.write(request_bytes.constData() + offset, request_bytes.size() - offset);
+        auto const len = socket->write(request_bytes.constData() + offset, request_bytes.size() - offset);
         if(len <= 0)
         {
-            socket.close();
+            socket->close();
             return;
         }
         offset += len;
     }
+
+    request_timing.mark(RequestTiming::RequestSent);
+
+    timeout.arm(NetworkTimeouts::firstByte(), "The host did not respond in time");
 }
 
 void GeminiClient::socketReadyRead()
 {
-    QByteArray response = socket.readAll();
+    request_timing.markOnce(RequestTiming::FirstByte);
+
+    timeout.arm(NetworkTimeouts::idle(), "The connection stalled");
+
+    QByteArray response = socket->readAll();
 
     if(is_receiving_body)
     {
@@ -106,30 +247,32 @@ void GeminiClient::socketReadyRead()
         for(int i = 0; i < response.size(); i++)
         {
             if(response[i] == '\n') {
+                // Closing the socket below must not fail the request
+                is_awaiting_header = false;
                 buffer.append(response.data(), i);
                 body.append(response.data() + i + 1, response.size() - i - 1);
 
                 // "XY " <META> <CR> <LF>
                 if(buffer.size() <= 5) {
-                    socket.close();
+                    socket->close();
                     qDebug() << buffer;
                     emit protocolViolation("Line is too short for valid protocol");
                     return;
                 }
                 if(buffer[buffer.size() - 1] != '\r') {
-                    socket.close();
+                    socket->close();
                     qDebug() << buffer;
                     emit protocolViolation("Line does not end with <CR> <LF>");
                     return;
                 }
                 if(not isdigit(buffer[0])) {
-                    socket.close();
+                    socket->close();
                     qDebug() << buffer;
                     emit protocolViolation("First character is not a digit.");
                     return;
                 }
                 if(not isdigit(buffer[1])) {
-                    socket.close();
+                    socket->close();
                     qDebug() << buffer;
                     emit protocolViolation("Second character is not a digit.");
                     return;
@@ -137,7 +280,7 @@ void GeminiClient::socketReadyRead()
                 // TODO: Implement stricter version
                 // if(buffer[2] != ' ') {
                 if(not isspace(buffer[2])) {
-                    socket.close();
+                    socket->close();
                     qDebug() << buffer;
                     emit protocolViolation("Third character is not a space.");
                     return;
@@ -148,11 +291,13 @@ void GeminiClient::socketReadyRead()
                 int primary_code = buffer[0] - '0';
                 int secondary_code = buffer[1] - '0';
 
+                status_code = 10 * primary_code + secondary_code;
+
                 qDebug() << primary_code << secondary_code << meta;
 
                 // We don't need to receive any data after that.
                 if(primary_code != 2)
-                    socket.close();
+                    socket->close();
 
                 switch(primary_code)
                 {
@@ -249,10 +394,20 @@ void GeminiClient::socketReadyRead()
 
 void GeminiClient::socketDisconnected()
 {
+    timeout.stop();
+
     if(is_receiving_body) {
-        body.append(socket.readAll());
+        body.append(socket->readAll());
+        request_timing.mark(RequestTiming::Transferred);
         emit requestComplete(body, mime_type);
     }
+    else if(is_awaiting_header) {
+        // The handshake failed or the host hung up before it answered
+        auto const error = socket->error();
+        failRequest((error == QAbstractSocket::UnknownSocketError or error == QAbstractSocket::RemoteHostClosedError)
+            ? QString("The host closed the connection without a response")
+            : socket->errorString());
+    }
 }
 
 void GeminiClient::sslErrors(const QList<QSslError> &errors)
@@ -261,7 +416,7 @@ void GeminiClient::sslErrors(const QList<QSslError> &errors)
         qWarning() << error.errorString() ;
     }
 
-    socket.ignoreSslErrors(errors);
+    socket->ignoreSslErrors(errors);
 }
 
 void GeminiClient::socketError(QAbstractSocket::SocketError socketError)
@@ -270,8 +425,10 @@ void GeminiClient::socketError(QAbstractSocket::SocketError socketError)
     // This is more sane then erroring out here as it's a perfectly legal
     // state and we know the TLS connection has ended.
     if(socketError == QAbstractSocket::RemoteHostClosedError) {
-        socket.close();
+        socket->close();
     } else {
-        qWarning() << socketError << socket.errorString();
+        qWarning() << socketError << socket->errorString();
+        if(is_awaiting_header or is_receiving_body)
+            failRequest(socket->errorString());
     }
 }
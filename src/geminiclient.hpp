@@ -4,9 +4,13 @@
 #include <QObject>
 #include <QMimeType>
 #include <QSslSocket>
+#include <QSslConfiguration>
 #include <QUrl>
+#include <atomic>
 
 #include "cryptoidentity.hpp"
+#include "requesttiming.hpp"
+#include "hostconnector.hpp"
 
 enum class TemporaryFailure {
     unspecified,
@@ -31,6 +35,10 @@ enum class CertificateRejection {
     expired_certificate_rejected,
 };
 
+Q_DECLARE_METATYPE(TemporaryFailure)
+Q_DECLARE_METATYPE(PermanentFailure)
+Q_DECLARE_METATYPE(CertificateRejection)
+
 class GeminiClient : public QObject
 {
 private:
@@ -40,15 +48,36 @@ public:
 
     ~GeminiClient() override;
 
+    //! Starts the request on the thread of the client. Returns false if
+    //! `url` can't be handled by this client. Must be called from the GUI
+    //! thread, which owns the preconnected sockets.
     bool startRequest(QUrl const & url);
 
+    //! Must be called on the thread of the client.
     bool isInProgress() const;
 
+    //! Cancels the current request and waits for the thread of the client to
+    //! do so. Signals that were queued before are still delivered.
     bool cancelRequest();
 
+    //! TLS configuration of all gemini connections
+    static QSslConfiguration sslConfiguration();
+
+    //! Sends `ident` with all requests that are not covered
+    //! by a scoped identity of `global_identities`.
     void enableClientCertificate(CryptoIdentity const & ident);
     void disableClientCertificate();
 
+    //! Phase timestamps of the current or last request
+    RequestTiming timing() const {
+        return request_timing.get();
+    }
+
+    //! Status code of the last response or 0 if none was received
+    int statusCode() const {
+        return status_code;
+    }
+
 signals:
     void requestProgress(qint64 transferred);
 
@@ -70,8 +99,23 @@ signals:
 
     void certificateRejected(CertificateRejection reason, QString const & info);
 
+    //! The host presented another certificate than the one pinned
+    //! in `global_known_hosts`, the request was aborted.
+    void hostCertificateMismatch(QString const & info);
+
+    //! The host could not be reached or did not answer in time.
+    void requestFailed(QString const & message);
+
 private slots:
 
+    void socketHostFound();
+
+    void hostConnected(QTcpSocket * socket);
+
+    void requestTimedOut(QString const & message);
+
+    void socketConnected();
+
     void socketEncrypted();
 
     void socketReadyRead();
@@ -82,15 +126,35 @@ private slots:
 
     void socketError(QAbstractSocket::SocketError socketError);
 
+private:
+    //! Sends the request for `url` with `identity`. `warm_socket` is a
+    //! preconnected socket for the host of `url` or nullptr.
+    void beginRequest(QUrl const & url, CryptoIdentity const & identity, QSslSocket * warm_socket);
+
+    void abortRequest();
+
+    //! Aborts the request and reports it as failed with `message`.
+    void failRequest(QString const & message);
+
+    //! Replaces the current socket with `socket` and takes ownership of it.
+    void setSocket(QSslSocket * socket);
 
 private:
     bool is_receiving_body;
+    //! Set from sending the request until the response header arrives
+    bool is_awaiting_header = false;
 
     QUrl target_url;
-    QSslSocket socket;
+    QSslSocket * socket = nullptr;
+    HostConnector connector;
+    RequestTimeout timeout;
     QByteArray buffer;
     QByteArray body;
     QString mime_type;
+    SharedRequestTiming request_timing;
+    std::atomic<int> status_code { 0 };
+    //! Only accessed on the GUI thread
+    CryptoIdentity client_identity;
 };
 
 #endif // GEMINICLIENT_HPP
@@ -7,6 +7,7 @@
 #include <QDebug>
 
 #include "kristall.hpp"
+#include "tracer.hpp"
 
 static QByteArray trim_whitespace(QByteArray items)
 {
@@ -26,40 +27,21 @@ static QByteArray trim_whitespace(QByteArray items)
 std::unique_ptr<GeminiDocument> GeminiRenderer::render(
         const QByteArray &input,
         QUrl const &root_url,
-        DocumentStyle const & themed_style,
+        RenderStyle const & render_style,
         DocumentOutlineModel &outline)
 {
-    QTextCharFormat preformatted;
-    preformatted.setFont(themed_style.preformatted_font);
-    preformatted.setForeground(themed_style.preformatted_color);
+    TraceScope trace { "render", "GeminiRenderer::render" };
 
-    QTextCharFormat standard;
-    standard.setFont(themed_style.standard_font);
-    standard.setForeground(themed_style.standard_color);
+    auto const & themed_style = render_style.style;
 
-    QTextCharFormat standard_link;
-    standard_link.setFont(themed_style.standard_font);
-    standard_link.setForeground(QBrush(themed_style.internal_link_color));
-
-    QTextCharFormat external_link;
-    external_link.setFont(themed_style.standard_font);
-    external_link.setForeground(QBrush(themed_style.external_link_color));
-
-    QTextCharFormat cross_protocol_link;
-    cross_protocol_link.setFont(themed_style.standard_font);
-    cross_protocol_link.setForeground(QBrush(themed_style.cross_scheme_link_color));
-
-    QTextCharFormat standard_h1;
-    standard_h1.setFont(themed_style.h1_font);
-    standard_h1.setForeground(QBrush(themed_style.h1_color));
-
-    QTextCharFormat standard_h2;
-    standard_h2.setFont(themed_style.h2_font);
-    standard_h2.setForeground(QBrush(themed_style.h2_color));
-
-    QTextCharFormat standard_h3;
-    standard_h3.setFont(themed_style.h3_font);
-    standard_h3.setForeground(QBrush(themed_style.h3_color));
+    QTextCharFormat const & preformatted = render_style.preformatted;
+    QTextCharFormat const & standard = render_style.standard;
+    QTextCharFormat const & standard_link = render_style.internal_link;
+    QTextCharFormat const & external_link = render_style.external_link;
+    QTextCharFormat const & cross_protocol_link = render_style.cross_scheme_link;
+    QTextCharFormat const & standard_h1 = render_style.h1;
+    QTextCharFormat const & standard_h2 = render_style.h2;
+    QTextCharFormat const & standard_h3 = render_style.h3;
 
     std::unique_ptr<GeminiDocument> result = std::make_unique<GeminiDocument>();
     result->setDocumentMargin(themed_style.margin);
@@ -72,12 +54,8 @@ std::unique_ptr<GeminiDocument> GeminiRenderer::render(
 
     QTextBlockFormat standard_format = cursor.blockFormat();
 
-    QTextBlockFormat preformatted_format = standard_format;
-    preformatted_format.setNonBreakableLines(true);
-
-    QTextBlockFormat block_quote_format = standard_format;
-    block_quote_format.setIndent(1);
-    block_quote_format.setBackground(themed_style.blockquote_color);
+    QTextBlockFormat const & preformatted_format = render_style.preformatted_block;
+    QTextBlockFormat const & block_quote_format = render_style.block_quote_block;
 
 
     bool verbatim = false;
@@ -283,6 +261,7 @@ std::unique_ptr<GeminiDocument> GeminiRenderer::render(
                             auto f = fmt.font();
                             f.setBold(rendering_bold);
                             fmt.setFont(f);
+                            fmt.setProperty(RenderStyle::bold_property, rendering_bold);
                             if(rendering_bold)
                                 cursor.insertText("*", fmt);
                         }
@@ -8,7 +8,7 @@
 
 #include "documentoutlinemodel.hpp"
 
-#include "documentstyle.hpp"
+#include "renderstyle.hpp"
 
 class GeminiDocument :
         public QTextDocument
@@ -33,7 +33,7 @@ struct GeminiRenderer
     static std::unique_ptr<GeminiDocument> render(
         QByteArray const & input,
         QUrl const & root_url,
-        DocumentStyle const & style,
+        RenderStyle const & style,
         DocumentOutlineModel & outline
     );
 };
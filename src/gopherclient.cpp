@@ -1,11 +1,30 @@
 #include "gopherclient.hpp"
 #include "ioutil.hpp"
+#include "networkthread.hpp"
+#include "gophermirrors.hpp"
 
-GopherClient::GopherClient(QObject *parent) : QObject(parent)
+//! Marks the end of text and menu responses
+static char const lone_dot[] = "\r\n.\r\n";
+static int const lone_dot_length = sizeof(lone_dot) - 1;
+
+GopherClient::GopherClient(QObject *parent) :
+    QObject(parent),
+    connector(this),
+    timeout(this)
 {
-    connect(&socket, &QTcpSocket::connected, this, &GopherClient::on_connected);
-    connect(&socket, &QTcpSocket::readyRead, this, &GopherClient::on_readRead);
-    connect(&socket, &QTcpSocket::disconnected, this, &GopherClient::on_finished);
+    connect(&connector, &HostConnector::hostFound, this, &GopherClient::on_hostFound);
+    connect(&connector, &HostConnector::connected, this, &GopherClient::on_hostConnected);
+    connect(&connector, &HostConnector::failed, this, [this](QString const & message) {
+        GopherMirrors::recordFailure(this->requested_url);
+        if(not this->mirrors.isEmpty()) {
+            this->connectToNextMirror();
+            return;
+        }
+        was_cancelled = true;
+        emit this->requestFailed(message);
+    });
+
+    connect(&timeout, &RequestTimeout::expired, this, &GopherClient::on_timeout);
 }
 
 GopherClient::~GopherClient()
@@ -15,12 +34,39 @@ GopherClient::~GopherClient()
 
 bool GopherClient::startRequest(const QUrl &url)
 {
-    if(isInProgress())
-        return false;
-
     if(url.scheme() != "gopher")
         return false;
 
+    auto const candidates = GopherMirrors::candidates(url);
+    QMetaObject::invokeMethod(this, [this, candidates]() {
+        this->beginRequest(candidates);
+    }, Qt::QueuedConnection);
+
+    return true;
+}
+
+bool GopherClient::isInProgress() const
+{
+    return (socket != nullptr and socket->isOpen()) or connector.isConnecting();
+}
+
+bool GopherClient::cancelRequest()
+{
+    NetworkThread::invokeBlocking(this, [this]() {
+        this->abortRequest();
+    });
+
+    return true;
+}
+
+void GopherClient::beginRequest(const QList<QUrl> &candidates)
+{
+    if(isInProgress())
+        this->abortRequest();
+
+    // All mirrors serve the same type
+    auto const url = candidates.first();
+
     // Second char on the URL path denotes the Gopher type
     // See https://tools.ietf.org/html/rfc4266
     QString type = url.path().mid(1, 1);
@@ -36,42 +82,101 @@ bool GopherClient::startRequest(const QUrl &url)
 
     is_processing_binary = (type == "5") or (type == "9") or (type == "I") or (type == "g");
 
-    this->requested_url = url;
+    this->mirrors = candidates;
     this->was_cancelled = false;
-    socket.connectToHost(url.host(), url.port(70));
-
-    return true;
+    this->body.clear();
+    this->scanned_size = 0;
+    this->streamed_size = 0;
+    this->request_timing.start();
+    this->connectToNextMirror();
 }
 
-bool GopherClient::isInProgress() const
+void GopherClient::connectToNextMirror()
 {
-    return socket.isOpen();
+    this->requested_url = this->mirrors.takeFirst();
+    this->connect_started = RequestTiming::now();
+    connector.connectToHost(requested_url.host(), quint16(requested_url.port(70)), []() {
+        return new QTcpSocket();
+    });
 }
 
-bool GopherClient::cancelRequest()
+void GopherClient::abortRequest()
 {
+    mirrors.clear();
+    connector.abort();
+    timeout.stop();
     was_cancelled = true;
-    socket.close();
+    if(socket != nullptr)
+        socket->close();
     body.clear();
-    return true;
+}
+
+void GopherClient::on_hostFound()
+{
+    this->request_timing.mark(RequestTiming::HostLookup);
+    this->connect_started = RequestTiming::now();
+}
+
+void GopherClient::on_hostConnected(QTcpSocket *socket)
+{
+    GopherMirrors::recordLatency(this->requested_url, RequestTiming::now() - this->connect_started);
+
+    HostConnector::replaceSocket(this, this->socket, socket);
+
+    connect(socket, &QTcpSocket::readyRead, this, &GopherClient::on_readRead);
+    connect(socket, &QTcpSocket::disconnected, this, &GopherClient::on_finished);
+
+    this->on_connected();
 }
 
 void GopherClient::on_connected()
 {
+    this->request_timing.mark(RequestTiming::Connected);
+
     auto blob = (requested_url.path().mid(2) + "\r\n").toUtf8();
 
-    IoUtil::writeAll(socket, blob);
+    IoUtil::writeAll(*socket, blob);
+
+    this->request_timing.mark(RequestTiming::RequestSent);
+
+    timeout.arm(NetworkTimeouts::firstByte(), "The host did not respond in time");
 }
 
 void GopherClient::on_readRead()
 {
-    body.append(socket.readAll());
+    this->request_timing.markOnce(RequestTiming::FirstByte);
+
+    timeout.arm(NetworkTimeouts::idle(), "The connection stalled");
+
+    auto const chunk = socket->readAll();
+    int const chunk_offset = body.size();
+    body.append(chunk);
 
     if(not is_processing_binary) {
-        // Strip the "lone dot" from gopher data
-        if(int index = body.indexOf("\r\n.\r\n"); index >= 0) {
-            body.resize(index + 2);
-            socket.close();
+        // Strip the "lone dot" from gopher data. Only the new bytes and the
+        // end of the previous read can contain it.
+        int const scan_from = qMax(0, scanned_size - (lone_dot_length - 1));
+        int const terminator = body.indexOf(lone_dot, scan_from);
+        if(terminator >= 0) {
+            body.resize(terminator + 2);
+        }
+        scanned_size = body.size();
+
+        if(mime == "text/plain" or mime == "text/gophermap") {
+            int line_end = streamed_size;
+            if(int index = chunk.lastIndexOf('\n'); index >= 0)
+                line_end = qMin(chunk_offset + index + 1, body.size());
+            if(line_end > streamed_size) {
+                emit this->requestData(body.mid(streamed_size, line_end - streamed_size), mime);
+                streamed_size = line_end;
+            }
+        }
+
+        // Closing finishes the request, so the data above is sent first
+        if(terminator >= 0) {
+            emit this->requestProgress(body.size());
+            socket->close();
+            return;
         }
     }
 
@@ -80,10 +185,28 @@ void GopherClient::on_readRead()
 
 void GopherClient::on_finished()
 {
+    timeout.stop();
+
     if(not was_cancelled)
     {
+        this->request_timing.mark(RequestTiming::Transferred);
         emit this->requestComplete(this->body, mime);
         was_cancelled = true;
     }
     body.clear();
 }
+
+void GopherClient::on_timeout(const QString &message)
+{
+    // A mirror that doesn't answer at all is replaced by the next one
+    if(body.isEmpty() and not mirrors.isEmpty())
+    {
+        GopherMirrors::recordFailure(this->requested_url);
+        HostConnector::replaceSocket<QTcpSocket>(this, this->socket, nullptr);
+        this->connectToNextMirror();
+        return;
+    }
+
+    this->abortRequest();
+    emit this->requestFailed(message);
+}
@@ -4,6 +4,10 @@
 #include <QObject>
 #include <QTcpSocket>
 #include <QUrl>
+#include <QList>
+
+#include "requesttiming.hpp"
+#include "hostconnector.hpp"
 
 class GopherClient : public QObject
 {
@@ -13,29 +17,64 @@ public:
 
     ~GopherClient() override;
 
+    //! Starts the request on the thread of the client. Returns false if
+    //! `url` can't be handled by this client.
     bool startRequest(QUrl const & url);
 
+    //! Must be called on the thread of the client.
     bool isInProgress() const;
 
+    //! Cancels the current request and waits for the thread of the client to
+    //! do so. Signals that were queued before are still delivered.
     bool cancelRequest();
 
+    //! Phase timestamps of the current or last request
+    RequestTiming timing() const {
+        return request_timing.get();
+    }
+
 signals:
     void requestProgress(qint64 transferred);
 
+    //! Complete lines of a text or menu response that arrived since the last
+    //! signal. `requestComplete` still carries the whole response.
+    void requestData(QByteArray const & chunk, QString const & mime);
+
     void requestComplete(QByteArray const & data, QString const & mime);
 
     void requestFailed(QString const & message);
 
 private slots:
+    void on_hostFound();
+    void on_hostConnected(QTcpSocket * socket);
     void on_connected();
     void on_readRead();
     void on_finished();
+    void on_timeout(QString const & message);
+
+private:
+    //! Requests the first of `candidates`, the others are mirrors to fall back to.
+    void beginRequest(QList<QUrl> const & candidates);
+
+    void connectToNextMirror();
+
+    void abortRequest();
 
 private:
-    QTcpSocket socket;
+    QTcpSocket * socket = nullptr;
+    HostConnector connector;
+    RequestTimeout timeout;
     QByteArray body;
+    //! Bytes of `body` that were already searched for the terminator
+    int scanned_size;
+    //! Bytes of `body` that were already sent with `requestData`
+    int streamed_size;
     QUrl requested_url;
+    //! Mirrors that are tried if `requested_url` can't be reached
+    QList<QUrl> mirrors;
+    qint64 connect_started = 0;
     bool was_cancelled;
+    SharedRequestTiming request_timing;
     QString mime;
     bool is_processing_binary;
 };
@@ -10,183 +10,229 @@
 #include <QImage>
 
 #include "kristall.hpp"
+#include "tracer.hpp"
+#include "iconcache.hpp"
+#include "gophermirrors.hpp"
 
 
-std::unique_ptr<QTextDocument> GophermapRenderer::render(const QByteArray &input, const QUrl &root_url, const DocumentStyle &themed_style)
-{
-    QTextCharFormat standard;
-    standard.setFont(themed_style.preformatted_font);
-    standard.setForeground(themed_style.preformatted_color);
+static char const * const icon_names[] = {
+    "binary", "directory", "dns", "error", "gif", "html",
+    "image", "mirror", "search", "sound", "telnet", "text",
+};
 
-    QTextCharFormat standard_link;
-    standard_link.setFont(themed_style.preformatted_font);
-    standard_link.setForeground(QBrush(themed_style.internal_link_color));
+//! Size of the gopher icons in device independent pixels
+static QSize const icon_size { 24, 24 };
 
-    QTextCharFormat external_link;
-    external_link.setFont(themed_style.standard_font);
-    external_link.setForeground(QBrush(themed_style.external_link_color));
+//! Adds the gopher icons to `document`. The rasterized images are
+//! shared by all documents.
+static void addIcons(QTextDocument & document)
+{
+    for(auto const * name : icon_names)
+    {
+        auto const image = IconCache::get(QString(":/icons/gopher/%1.svg").arg(name), icon_size);
+        document.addResource(QTextDocument::ImageResource, QUrl(QString("gopher/%1").arg(name)), QVariant::fromValue(image));
+    }
+}
 
-    bool emit_text_only = (global_settings.value("gophermap_display").toString() == "text");
+GophermapRenderer::Stream::Stream(QTextDocument &document, const QUrl &root_url, const RenderStyle &themed_style) :
+    root_url(root_url),
+    cursor(&document),
+    emit_text_only(global_settings.value("gophermap_display").toString() == "text")
+{
+    standard = themed_style.preformatted;
 
-    std::unique_ptr<QTextDocument> result = std::make_unique<QTextDocument>();
-    result->setDocumentMargin(themed_style.margin);
+    standard_link = themed_style.preformatted_link;
+
+    document.setDocumentMargin(themed_style.style.margin);
 
     if(not emit_text_only)
     {
-        result->addResource(QTextDocument::ImageResource, QUrl("gopher/binary"), QVariant::fromValue(QImage(":/icons/gopher/binary.svg")));
-        result->addResource(QTextDocument::ImageResource, QUrl("gopher/directory"), QVariant::fromValue(QImage(":/icons/gopher/directory.svg")));
-        result->addResource(QTextDocument::ImageResource, QUrl("gopher/dns"), QVariant::fromValue(QImage(":/icons/gopher/dns.svg")));
-        result->addResource(QTextDocument::ImageResource, QUrl("gopher/error"), QVariant::fromValue(QImage(":/icons/gopher/error.svg")));
-        result->addResource(QTextDocument::ImageResource, QUrl("gopher/gif"), QVariant::fromValue(QImage(":/icons/gopher/gif.svg")));
-        result->addResource(QTextDocument::ImageResource, QUrl("gopher/html"), QVariant::fromValue(QImage(":/icons/gopher/html.svg")));
-        result->addResource(QTextDocument::ImageResource, QUrl("gopher/image"), QVariant::fromValue(QImage(":/icons/gopher/image.svg")));
-        result->addResource(QTextDocument::ImageResource, QUrl("gopher/mirror"), QVariant::fromValue(QImage(":/icons/gopher/mirror.svg")));
-        result->addResource(QTextDocument::ImageResource, QUrl("gopher/search"), QVariant::fromValue(QImage(":/icons/gopher/search.svg")));
-        result->addResource(QTextDocument::ImageResource, QUrl("gopher/sound"), QVariant::fromValue(QImage(":/icons/gopher/sound.svg")));
-        result->addResource(QTextDocument::ImageResource, QUrl("gopher/telnet"), QVariant::fromValue(QImage(":/icons/gopher/telnet.svg")));
-        result->addResource(QTextDocument::ImageResource, QUrl("gopher/text"), QVariant::fromValue(QImage(":/icons/gopher/text.svg")));
+        addIcons(document);
     }
 
-    QTextCursor cursor{result.get()};
-
-    QTextBlockFormat non_list_format = cursor.blockFormat();
+    cursor.movePosition(QTextCursor::End);
+}
 
-    char last_type = '1';
+GophermapRenderer::Stream::~Stream()
+{
+    this->flushMirrors();
+}
 
-    QList<QByteArray> lines = input.split('\n');
-    for (auto const &line : lines)
+void GophermapRenderer::Stream::append(const QByteArray &input)
+{
+    int begin = 0;
+    while(begin < input.size())
     {
-        if (line.length() < 2) // skip lines without
-            continue;
+        int end = input.indexOf('\n', begin);
+        if(end < 0)
+            end = input.size();
+
+        this->appendLine(QByteArray::fromRawData(input.constData() + begin, end - begin));
 
-        if (line[line.size() - 1] != '\r')
-            continue;
+        begin = end + 1;
+    }
+}
+
+void GophermapRenderer::Stream::appendLine(const QByteArray &line)
+{
+    if (line.length() < 2) // skip lines without
+        return;
+
+    if (line[line.size() - 1] != '\r')
+        return;
+
+    auto items = line.mid(1, line.length() - 2).split('\t');
+    if (items.size() < 2) // invalid
+        return;
+
+    QString icon;
+    QString scheme = "gopher";
 
-        auto items = line.mid(1, line.length() - 2).split('\t');
-        if (items.size() < 2) // invalid
-            continue;
+    auto type = line.at(0);
+    switch (type)
+    {
+    case '0': // Text File
+        icon = "text";
+        break;
+    case '1': // Gopher submenu or link to another gopher server
+        icon = "directory";
+        break;
+    case '2': // CCSO Nameserver
+        icon = "dns";
+        break;
+    case '3': // Error code returned by a Gopher server to indicate failure
+        icon = "error";
+        break;
+    case '4': // BinHex-encoded file (primarily for Macintosh computers)
+        icon = "binary";
+        break;
+    case '5': // DOS file
+        icon = "binary";
+        break;
+    case '6': // uuencoded file
+        icon = "binary";
+        break;
+    case '7': // Gopher full-text search
+        icon = "search";
+        break;
+    case '8': // Telnet
+        icon = "telnet";
+        scheme = "telnet";
+        break;
+    case '9': // Binary file
+        icon = "binary";
+        break;
+    case '+': // Mirror or alternate server (for load balancing or in case of primary server downtime)
+        icon = "mirror";
+        break;
+    case 'g': // GIF file
+        icon = "gif";
+        break;
+    case 'I': // Image file
+        icon = "image";
+        break;
+    case 'T': // Telnet 3270
+        icon = "telnet";
+        scheme = "telnet";
+        break;
+    //Non-Canonical Types
+    case 'h': // HTML file
+        icon = "html";
+        break;
+    case 'i': // Informational message
+        icon = "informational";
+        break;
+    case 's': // Sound file
+        icon = "sound";
+        break;
+    default: // unknown
+        return;
+    }
+    bool const is_mirror = (type == '+');
+    if(is_mirror) {
+        type = last_type;
+    } else {
+        last_type = type;
+    }
 
-        QString icon;
-        QString scheme = "gopher";
+    QString title = items.at(0);
 
-        auto type = line.at(0);
-        switch (type)
+    if (type == 'i')
+    {
+        this->flushMirrors();
+        cursor.insertText(title + "\n", standard);
+    }
+    else
+    {
+        QString dst_url;
+        switch (items.size())
         {
-        case '0': // Text File
-            icon = "text";
-            break;
-        case '1': // Gopher submenu or link to another gopher server
-            icon = "directory";
+        case 0:
+            assert(false);
+        case 1:
+            assert(false);
+        case 2:
+            dst_url = root_url.resolved(QUrl(items.at(1))).toString();
             break;
-        case '2': // CCSO Nameserver
-            icon = "dns";
+        case 3:
+            dst_url = scheme + "://" + items.at(2) + "/" + QString(type) + items.at(1);
             break;
-        case '3': // Error code returned by a Gopher server to indicate failure
-            icon = "error";
+        default:
+            dst_url = scheme + "://" + items.at(2) + ":" + items.at(3) + "/" + QString(type) + items.at(1);
             break;
-        case '4': // BinHex-encoded file (primarily for Macintosh computers)
-            icon = "binary";
-            break;
-        case '5': // DOS file
-            icon = "binary";
-            break;
-        case '6': // uuencoded file
-            icon = "binary";
-            break;
-        case '7': // Gopher full-text search
-            icon = "search";
-            break;
-        case '8': // Telnet
-            icon = "telnet";
-            scheme = "telnet";
-            break;
-        case '9': // Binary file
-            icon = "binary";
-            break;
-        case '+': // Mirror or alternate server (for load balancing or in case of primary server downtime)
-            icon = "mirror";
-            break;
-        case 'g': // GIF file
-            icon = "gif";
-            break;
-        case 'I': // Image file
-            icon = "image";
-            break;
-        case 'T': // Telnet 3270
-            icon = "telnet";
-            scheme = "telnet";
-            break;
-        //Non-Canonical Types
-        case 'h': // HTML file
-            icon = "html";
-            break;
-        case 'i': // Informational message
-            icon = "informational";
-            break;
-        case 's': // Sound file
-            icon = "sound";
-            break;
-        default: // unknown
-            continue;
         }
-        if(type == '+') {
-            type = last_type;
-        } else {
-            last_type = type;
+
+        if (not QUrl(dst_url).isValid())
+        {
+            // invlaid URL generated
+            qDebug() << line << dst_url;
         }
 
-        QString title = items.at(0);
+        // Mirrors follow the item they serve
+        if(not is_mirror) {
+            this->flushMirrors();
+        }
+        if(scheme == "gopher" and (not is_mirror or not mirror_group.isEmpty())) {
+            mirror_group.append(QUrl(dst_url));
+        }
 
-        if (type == 'i')
+        if(emit_text_only)
         {
-            cursor.insertText(title + "\n", standard);
+            cursor.insertText("[" + icon + "] ", standard);
         }
         else
         {
-            QString dst_url;
-            switch (items.size())
-            {
-            case 0:
-                assert(false);
-            case 1:
-                assert(false);
-            case 2:
-                dst_url = root_url.resolved(QUrl(items.at(1))).toString();
-                break;
-            case 3:
-                dst_url = scheme + "://" + items.at(2) + "/" + QString(type) + items.at(1);
-                break;
-            default:
-                dst_url = scheme + "://" + items.at(2) + ":" + items.at(3) + "/" + QString(type) + items.at(1);
-                break;
-            }
-
-            if (not QUrl(dst_url).isValid())
-            {
-                // invlaid URL generated
-                qDebug() << line << dst_url;
-            }
-
-            if(emit_text_only)
-            {
-                cursor.insertText("[" + icon + "] ", standard);
-            }
-            else
-            {
-                QTextImageFormat icon_fmt;
-                icon_fmt.setName(QString("gopher/%1").arg(icon));
-                icon_fmt.setVerticalAlignment(QTextImageFormat::AlignTop);
-
-                cursor.insertImage(icon_fmt);
-                cursor.insertText(" ");
-            }
-
-            QTextCharFormat fmt = standard_link;
-            fmt.setAnchor(true);
-            fmt.setAnchorHref(dst_url);
-            cursor.insertText(title + "\n", fmt);
+            QTextImageFormat icon_fmt;
+            icon_fmt.setName(QString("gopher/%1").arg(icon));
+            icon_fmt.setWidth(icon_size.width());
+            icon_fmt.setHeight(icon_size.height());
+            icon_fmt.setVerticalAlignment(QTextImageFormat::AlignTop);
+
+            cursor.insertImage(icon_fmt);
+            cursor.insertText(" ");
         }
+
+        QTextCharFormat fmt = standard_link;
+        fmt.setAnchor(true);
+        fmt.setAnchorHref(dst_url);
+        cursor.insertText(title + "\n", fmt);
     }
+}
+
+void GophermapRenderer::Stream::flushMirrors()
+{
+    GopherMirrors::addGroup(mirror_group);
+    mirror_group.clear();
+}
+
+std::unique_ptr<QTextDocument> GophermapRenderer::render(const QByteArray &input, const QUrl &root_url, const RenderStyle &themed_style)
+{
+    TraceScope trace { "render", "GophermapRenderer::render" };
+
+    std::unique_ptr<QTextDocument> result = std::make_unique<QTextDocument>();
+
+    Stream stream { *result, root_url, themed_style };
+    stream.append(input);
 
     return result;
 }
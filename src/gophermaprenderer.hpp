@@ -1,25 +1,60 @@
 #ifndef GOPHERMAPRENDERER_HPP
 #define GOPHERMAPRENDERER_HPP
 
-#include "documentstyle.hpp"
+#include "renderstyle.hpp"
 
 #include <memory>
 #include <QTextDocument>
+#include <QTextCursor>
+#include <QTextCharFormat>
+#include <QList>
 
 struct GophermapRenderer
 {
     GophermapRenderer() = delete;
 
+    //! Renders a gophermap into a document line by line, so a menu can
+    //! be shown while it is still being received.
+    class Stream
+    {
+    public:
+        //! Prepares `document` for the menu at `root_url`. The stream must
+        //! not outlive the document.
+        Stream(QTextDocument & document, QUrl const & root_url, RenderStyle const & style);
+
+        Stream(Stream const &) = delete;
+
+        ~Stream();
+
+        //! Renders the complete lines in `input` at the end of the document.
+        void append(QByteArray const & input);
+
+    private:
+        void appendLine(QByteArray const & line);
+
+        //! Registers the last item and its mirrors with GopherMirrors.
+        void flushMirrors();
+
+    private:
+        QUrl root_url;
+        QTextCursor cursor;
+        bool emit_text_only;
+        char last_type = '1';
+        //! The last item followed by its mirrors
+        QList<QUrl> mirror_group;
+
+        QTextCharFormat standard;
+        QTextCharFormat standard_link;
+    };
 
     //! Renders the given byte sequence into a GeminiDocument.
     //! @param input    The utf8 encoded input string
     //! @param root_url The url that is used to resolve relative links
     //! @param style    The style which is used to render the document
-    //! @param outline  The extracted outline from the document
     static std::unique_ptr<QTextDocument> render(
         QByteArray const & input,
         QUrl const & root_url,
-        DocumentStyle const & style
+        RenderStyle const & style
     );
 };
 
@@ -0,0 +1,128 @@
+#include "gophermirrors.hpp"
+
+#include <QHash>
+#include <QQueue>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSharedPointer>
+#include <QPair>
+#include <algorithm>
+
+using Group = QSharedPointer<QList<QUrl>>;
+
+//! Older groups are forgotten when more menus than this were seen
+static int const max_groups = 4096;
+
+//! Latency counted for a host that failed, so it is tried last
+static qint64 const failure_penalty = 60 * qint64(1000000);
+
+static QMutex mutex;
+static QHash<QString, Group> groups;
+static QQueue<Group> group_order;
+static QHash<QString, qint64> latencies;
+
+static QString urlKey(QUrl const & url)
+{
+    return url.adjusted(QUrl::RemoveFragment).toString(QUrl::FullyEncoded);
+}
+
+static QString hostKey(QUrl const & url)
+{
+    return url.host() + ":" + QString::number(url.port(70));
+}
+
+void GopherMirrors::addGroup(const QList<QUrl> &urls)
+{
+    if(urls.size() < 2)
+        return;
+
+    QMutexLocker lock { &mutex };
+
+    auto const group = Group::create(urls);
+    for(auto const & url : urls)
+    {
+        groups.insert(urlKey(url), group);
+    }
+    group_order.enqueue(group);
+
+    while(group_order.size() > max_groups)
+    {
+        auto const oldest = group_order.dequeue();
+        for(auto const & url : *oldest)
+        {
+            auto it = groups.find(urlKey(url));
+            if(it != groups.end() and it.value() == oldest)
+                groups.erase(it);
+        }
+    }
+}
+
+QList<QUrl> GopherMirrors::candidates(const QUrl &url)
+{
+    QMutexLocker lock { &mutex };
+
+    auto it = groups.find(urlKey(url));
+    if(it == groups.end())
+        return { url };
+
+    // Without measurements the followed item goes first, the others keep the menu order
+    QList<QUrl> result { url };
+    for(auto const & mirror : *it.value())
+    {
+        if(urlKey(mirror) != urlKey(url))
+            result.append(mirror);
+    }
+
+    // Measured hosts first, then unknown ones, then hosts that failed
+    auto const rank = [](QUrl const & url) {
+        auto const latency = latencies.value(hostKey(url), -1);
+        if(latency < 0)
+            return qMakePair(1, qint64(0));
+        if(latency >= failure_penalty)
+            return qMakePair(2, qint64(0));
+        return qMakePair(0, latency);
+    };
+    std::stable_sort(result.begin(), result.end(), [&rank](QUrl const & a, QUrl const & b) {
+        return rank(a) < rank(b);
+    });
+
+    return result;
+}
+
+void GopherMirrors::recordLatency(const QUrl &url, qint64 connect_time_us)
+{
+    QMutexLocker lock { &mutex };
+
+    auto const key = hostKey(url);
+    auto it = latencies.find(key);
+    if(it == latencies.end() or it.value() >= failure_penalty)
+        latencies.insert(key, connect_time_us);
+    else
+        it.value() = (3 * it.value() + connect_time_us) / 4;
+}
+
+void GopherMirrors::recordFailure(const QUrl &url)
+{
+    QMutexLocker lock { &mutex };
+    latencies.insert(hostKey(url), failure_penalty);
+}
+
+qint64 GopherMirrors::estimateMemoryUsage()
+{
+    QMutexLocker lock { &mutex };
+
+    qint64 size = 0;
+    for(auto const & group : group_order)
+    {
+        for(auto const & url : *group)
+        {
+            // One hash entry and one list entry per url
+            size += 64 + 2 * sizeof(QChar) * url.toString().size();
+        }
+    }
+    for(auto it = latencies.begin(); it != latencies.end(); ++it)
+    {
+        size += sizeof(qint64) + sizeof(QChar) * it.key().size();
+    }
+    return size;
+}
@@ -0,0 +1,32 @@
+#ifndef GOPHERMIRRORS_HPP
+#define GOPHERMIRRORS_HPP
+
+#include <QUrl>
+#include <QList>
+#include <QString>
+
+//! Remembers which gopher items are mirrors of each other ("+" entries
+//! in a menu) and how fast the hosts answered, so a request can go to the
+//! fastest mirror and fall back to the others if it fails.
+//! All functions are thread-safe, latencies are recorded on the network thread.
+struct GopherMirrors
+{
+    GopherMirrors() = delete;
+
+    //! Stores that all `urls` point to the same resource. The first one is the primary item.
+    static void addGroup(QList<QUrl> const & urls);
+
+    //! Returns `url` and all its known mirrors, ordered by the measured latency
+    //! of their hosts. Hosts without a measurement keep the menu order.
+    static QList<QUrl> candidates(QUrl const & url);
+
+    //! Records the time it took to connect to the host of `url`.
+    static void recordLatency(QUrl const & url, qint64 connect_time_us);
+
+    //! Records that the host of `url` could not be reached in time.
+    static void recordFailure(QUrl const & url);
+
+    static qint64 estimateMemoryUsage();
+};
+
+#endif // GOPHERMIRRORS_HPP
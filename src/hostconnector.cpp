@@ -0,0 +1,232 @@
+#include "hostconnector.hpp"
+
+#include <atomic>
+
+static std::atomic<int> connect_timeout { 10000 };
+static std::atomic<int> handshake_timeout { 10000 };
+static std::atomic<int> first_byte_timeout { 30000 };
+static std::atomic<int> idle_timeout { 30000 };
+static std::atomic<int> attempt_delay { 250 };
+
+void NetworkTimeouts::set(int connect, int handshake, int first_byte, int idle, int delay)
+{
+    connect_timeout = connect;
+    handshake_timeout = handshake;
+    first_byte_timeout = first_byte;
+    idle_timeout = idle;
+    attempt_delay = delay;
+}
+
+int NetworkTimeouts::connect()
+{
+    return connect_timeout;
+}
+
+int NetworkTimeouts::handshake()
+{
+    return handshake_timeout;
+}
+
+int NetworkTimeouts::firstByte()
+{
+    return first_byte_timeout;
+}
+
+int NetworkTimeouts::idle()
+{
+    return idle_timeout;
+}
+
+int NetworkTimeouts::attemptDelay()
+{
+    return attempt_delay;
+}
+
+RequestTimeout::RequestTimeout(QObject *parent) :
+    QObject(parent),
+    timer(this)
+{
+    timer.setSingleShot(true);
+    connect(&timer, &QTimer::timeout, this, [this]() {
+        emit this->expired(this->message);
+    });
+}
+
+void RequestTimeout::arm(int timeout_ms, const QString &message)
+{
+    if(timeout_ms <= 0) {
+        timer.stop();
+        return;
+    }
+    this->message = message;
+    timer.start(timeout_ms);
+}
+
+void RequestTimeout::stop()
+{
+    timer.stop();
+}
+
+HostConnector::HostConnector(QObject *parent) :
+    QObject(parent),
+    attempt_timer(this),
+    connect_timer(this)
+{
+    attempt_timer.setSingleShot(true);
+    connect_timer.setSingleShot(true);
+
+    connect(&attempt_timer, &QTimer::timeout, this, &HostConnector::attemptNext);
+    connect(&connect_timer, &QTimer::timeout, this, [this]() {
+        this->fail(QString("Connection to %1 timed out").arg(this->host));
+    });
+}
+
+HostConnector::~HostConnector()
+{
+    this->abort();
+}
+
+void HostConnector::connectToHost(const QString &host, quint16 port, const SocketFactory &factory)
+{
+    this->abort();
+
+    this->is_connecting = true;
+    this->host = host;
+    this->port = port;
+    this->factory = factory;
+    this->last_error = QString("Could not connect to %1").arg(host);
+
+    if(NetworkTimeouts::connect() > 0)
+        connect_timer.start(NetworkTimeouts::connect());
+
+    // Literal addresses need no lookup
+    QHostAddress literal;
+    if(literal.setAddress(host)) {
+        this->addresses = { literal };
+        emit this->hostFound();
+        this->attemptNext();
+        return;
+    }
+
+    this->lookup_id = QHostInfo::lookupHost(host, this, &HostConnector::lookupFinished);
+}
+
+void HostConnector::abort()
+{
+    if(this->lookup_id >= 0) {
+        QHostInfo::abortHostLookup(this->lookup_id);
+        this->lookup_id = -1;
+    }
+
+    attempt_timer.stop();
+    connect_timer.stop();
+
+    for(auto * socket : this->attempts)
+    {
+        socket->disconnect(this);
+        socket->abort();
+        socket->deleteLater();
+    }
+    this->attempts.clear();
+    this->addresses.clear();
+    this->next_address = 0;
+    this->is_connecting = false;
+}
+
+void HostConnector::lookupFinished(const QHostInfo &info)
+{
+    this->lookup_id = -1;
+
+    if(info.error() != QHostInfo::NoError or info.addresses().isEmpty()) {
+        this->fail(info.errorString());
+        return;
+    }
+
+    this->addresses = interleave(info.addresses());
+
+    emit this->hostFound();
+
+    this->attemptNext();
+}
+
+void HostConnector::attemptNext()
+{
+    if(this->next_address >= this->addresses.size())
+    {
+        if(this->attempts.isEmpty())
+            this->fail(this->last_error);
+        return;
+    }
+
+    auto const address = this->addresses[this->next_address++];
+
+    QTcpSocket * socket = this->factory();
+    socket->setParent(this);
+    this->attempts.append(socket);
+
+    connect(socket, &QTcpSocket::connected, this, [this, socket]() {
+        this->attemptConnected(socket);
+    });
+    connect(socket, QOverload<QAbstractSocket::SocketError>::of(&QTcpSocket::error), this, [this, socket](QAbstractSocket::SocketError) {
+        this->attemptFailed(socket);
+    });
+
+    socket->connectToHost(address, this->port);
+
+    if(this->next_address < this->addresses.size() and NetworkTimeouts::attemptDelay() > 0)
+        attempt_timer.start(NetworkTimeouts::attemptDelay());
+}
+
+void HostConnector::attemptConnected(QTcpSocket *socket)
+{
+    this->attempts.removeAll(socket);
+    socket->disconnect(this);
+    socket->setParent(nullptr);
+
+    this->abort();
+
+    emit this->connected(socket);
+}
+
+void HostConnector::attemptFailed(QTcpSocket *socket)
+{
+    if(not this->attempts.removeAll(socket))
+        return;
+
+    this->last_error = socket->errorString();
+    socket->disconnect(this);
+    socket->deleteLater();
+
+    // A failed attempt starts the next one right away
+    attempt_timer.stop();
+    this->attemptNext();
+}
+
+void HostConnector::fail(const QString &message)
+{
+    this->abort();
+    emit this->failed(message);
+}
+
+QList<QHostAddress> HostConnector::interleave(const QList<QHostAddress> &addresses)
+{
+    QList<QHostAddress> preferred, other;
+    auto const family = addresses.first().protocol();
+    for(auto const & address : addresses)
+    {
+        if(address.protocol() == family)
+            preferred.append(address);
+        else
+            other.append(address);
+    }
+
+    QList<QHostAddress> result;
+    while(not preferred.isEmpty() or not other.isEmpty())
+    {
+        if(not preferred.isEmpty())
+            result.append(preferred.takeFirst());
+        if(not other.isEmpty())
+            result.append(other.takeFirst());
+    }
+    return result;
+}
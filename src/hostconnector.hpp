@@ -0,0 +1,140 @@
+#ifndef HOSTCONNECTOR_HPP
+#define HOSTCONNECTOR_HPP
+
+#include <QObject>
+#include <QTimer>
+#include <QTcpSocket>
+#include <QHostInfo>
+#include <QHostAddress>
+#include <QList>
+#include <functional>
+
+//! Timeouts of the protocol clients in milliseconds. A value of 0
+//! disables the timeout. Set on the GUI thread, read on the network thread.
+struct NetworkTimeouts
+{
+    NetworkTimeouts() = delete;
+
+    static void set(int connect, int handshake, int first_byte, int idle, int attempt_delay);
+
+    //! From starting the host lookup until a connection is established
+    static int connect();
+
+    //! From the established connection until the TLS handshake is done
+    static int handshake();
+
+    //! From sending the request until the first byte of the response
+    static int firstByte();
+
+    //! Between two reads of the response
+    static int idle();
+
+    //! Delay before the next address is tried while the previous attempt is still running
+    static int attemptDelay();
+};
+
+//! The timeout of the current phase of a request. The protocol clients
+//! arm it whenever a phase starts, so it only expires when that phase
+//! takes too long.
+class RequestTimeout : public QObject
+{
+    Q_OBJECT
+public:
+    explicit RequestTimeout(QObject * parent = nullptr);
+
+    //! Emits expired() with `message` if the next step takes longer
+    //! than `timeout_ms`. A value of 0 disables the timeout.
+    void arm(int timeout_ms, QString const & message);
+
+    void stop();
+
+signals:
+    void expired(QString const & message);
+
+private:
+    QTimer timer;
+    QString message;
+};
+
+//! Connects to a host by racing its addresses as described in RFC 8305
+//! ("Happy Eyeballs"): IPv6 and IPv4 addresses are tried alternately, a new
+//! attempt is started when the previous one failed or did not succeed within
+//! the attempt delay, and the first established connection wins.
+class HostConnector : public QObject
+{
+    Q_OBJECT
+public:
+    //! Creates the unconnected socket for a single attempt
+    using SocketFactory = std::function<QTcpSocket*()>;
+
+    explicit HostConnector(QObject * parent = nullptr);
+
+    ~HostConnector() override;
+
+    //! Starts connecting to `host`, cancelling any previous attempt.
+    void connectToHost(QString const & host, quint16 port, SocketFactory const & factory);
+
+    //! Cancels the lookup and all running attempts.
+    void abort();
+
+    bool isConnecting() const {
+        return this->is_connecting;
+    }
+
+    //! Makes `socket` the socket of `owner` in place of `current`. The
+    //! previous socket is disconnected from `owner`, aborted and deleted.
+    //! `socket` may be nullptr to only drop the previous socket.
+    template<typename Socket>
+    static void replaceSocket(QObject * owner, Socket *& current, Socket * socket)
+    {
+        if(current != nullptr) {
+            current->disconnect(owner);
+            current->abort();
+            current->deleteLater();
+        }
+        current = socket;
+        if(socket != nullptr)
+            socket->setParent(owner);
+    }
+
+signals:
+    void hostFound();
+
+    //! `socket` is connected, the receiver takes ownership of it.
+    void connected(QTcpSocket * socket);
+
+    void failed(QString const & message);
+
+private slots:
+    void lookupFinished(QHostInfo const & info);
+
+    void attemptNext();
+
+private:
+    void attemptConnected(QTcpSocket * socket);
+
+    void attemptFailed(QTcpSocket * socket);
+
+    void fail(QString const & message);
+
+    //! Orders `addresses` alternating between the address families,
+    //! starting with the family of the first address.
+    static QList<QHostAddress> interleave(QList<QHostAddress> const & addresses);
+
+private:
+    bool is_connecting = false;
+    int lookup_id = -1;
+    QString host;
+    quint16 port = 0;
+    SocketFactory factory;
+
+    QList<QHostAddress> addresses;
+    int next_address = 0;
+    QList<QTcpSocket*> attempts;
+    QString last_error;
+
+    QTimer attempt_timer;
+    QTimer connect_timer;
+};
+
+#endif // HOSTCONNECTOR_HPP
@@ -0,0 +1,72 @@
+#include "iconcache.hpp"
+#include "tracer.hpp"
+
+#include <QHash>
+#include <QImageReader>
+#include <QGuiApplication>
+#include <QScreen>
+
+static QHash<QString, QImage> icons;
+static bool is_watching_screens = false;
+
+static void watchScreen(QScreen * screen)
+{
+    QObject::connect(screen, &QScreen::logicalDotsPerInchChanged, qApp, &IconCache::invalidate);
+}
+
+//! Icons depend on the device pixel ratio, which changes with the screens
+static void watchScreens()
+{
+    if(is_watching_screens or qApp == nullptr)
+        return;
+    is_watching_screens = true;
+
+    for(auto * screen : QGuiApplication::screens())
+    {
+        watchScreen(screen);
+    }
+    QObject::connect(qApp, &QGuiApplication::screenAdded, qApp, [](QScreen * screen) {
+        watchScreen(screen);
+        IconCache::invalidate();
+    });
+    QObject::connect(qApp, &QGuiApplication::screenRemoved, qApp, &IconCache::invalidate);
+    QObject::connect(qApp, &QGuiApplication::primaryScreenChanged, qApp, &IconCache::invalidate);
+}
+
+QImage IconCache::get(const QString &file_name, const QSize &size)
+{
+    watchScreens();
+
+    qreal const ratio = (qApp != nullptr) ? qApp->devicePixelRatio() : 1.0;
+    auto const key = QString("%1@%2x%3@%4").arg(file_name).arg(size.width()).arg(size.height()).arg(ratio);
+
+    auto it = icons.find(key);
+    if(it != icons.end())
+        return it.value();
+
+    TraceScope trace { "render", "IconCache::get" };
+
+    QImageReader reader { file_name };
+    reader.setScaledSize(size * ratio);
+
+    QImage image = reader.read();
+    image.setDevicePixelRatio(ratio);
+
+    icons.insert(key, image);
+    return image;
+}
+
+void IconCache::invalidate()
+{
+    icons.clear();
+}
+
+qint64 IconCache::estimateMemoryUsage()
+{
+    qint64 size = 0;
+    for(auto const & image : icons)
+    {
+        size += image.sizeInBytes();
+    }
+    return size;
+}
@@ -0,0 +1,25 @@
+#ifndef ICONCACHE_HPP
+#define ICONCACHE_HPP
+
+#include <QImage>
+#include <QSize>
+#include <QString>
+
+//! Rasterizes icons from resources once per size and device pixel ratio
+//! and shares the images between all documents and tabs. The cache is
+//! dropped when the theme or the screen resolution changes.
+//! Must only be used from the GUI thread.
+struct IconCache
+{
+    IconCache() = delete;
+
+    //! Returns the image `file_name` rasterized for `size` device independent
+    //! pixels at the current device pixel ratio.
+    static QImage get(QString const & file_name, QSize const & size);
+
+    static void invalidate();
+
+    static qint64 estimateMemoryUsage();
+};
+
+#endif // ICONCACHE_HPP
@@ -1,8 +1,35 @@
 #include "identitycollection.hpp"
 
 #include <cassert>
+#include <algorithm>
 #include <QDebug>
 #include <QIcon>
+#include <QDateTime>
+#include <QCryptographicHash>
+
+static QByteArray fingerprint(QByteArray const & certificate_der)
+{
+    return QCryptographicHash::hash(certificate_der, QCryptographicHash::Sha256).toHex();
+}
+
+CryptoIdentity const & IdentityCollection::IdentityNode::decoded() const
+{
+    if(not this->is_decoded)
+    {
+        this->is_decoded = true;
+
+        auto const certificates = QSslCertificate::fromData(this->certificate_der, QSsl::Der);
+        if(not certificates.isEmpty())
+            this->identity.certificate = certificates.first();
+
+        this->identity.private_key = QSslKey(
+            this->private_key_der,
+            this->key_algorithm,
+            QSsl::Der
+        );
+    }
+    return this->identity;
+}
 
 IdentityCollection::IdentityCollection(QObject *parent)
     : QAbstractItemModel(parent)
@@ -14,6 +41,7 @@ void IdentityCollection::load(QSettings &settings)
     this->beginResetModel();
 
     this->root.children.clear();
+    this->scopes.clear();
 
     int group_cnt = settings.beginReadArray("groups");
     for(int i = 0; i < group_cnt; i++)
@@ -33,16 +61,11 @@ void IdentityCollection::load(QSettings &settings)
             id->identity.is_persistent = true;
             id->identity.display_name = settings.value("display_name").toString();
 
-            id->identity.certificate = QSslCertificate::fromData(
-                settings.value("certificate").toByteArray(),
-                QSsl::Der
-            ).first();
-
-            id->identity.private_key = QSslKey(
-                settings.value("private_key").toByteArray(),
-                QSsl::Rsa,
-                QSsl::Der
-            );
+            // Key material is decoded on first use, which keeps startup
+            // fast with many identities.
+            id->certificate_der = settings.value("certificate").toByteArray();
+            id->private_key_der = settings.value("private_key").toByteArray();
+            id->key_algorithm = (settings.value("key_type", "rsa").toString() == "ec") ? QSsl::Ec : QSsl::Rsa;
 
             group->children.emplace_back(std::move(id));
         }
@@ -53,6 +76,37 @@ void IdentityCollection::load(QSettings &settings)
     }
     settings.endArray();
 
+    QHash<QByteArray, IdentityNode const *> identities;
+    for(auto const & grp : root.children)
+    {
+        for(auto const & id : grp->children)
+        {
+            auto const & node = id->as<IdentityNode>();
+            identities.insert(fingerprint(node.certificate_der), &node);
+        }
+    }
+
+    int scope_cnt = settings.beginReadArray("scopes");
+    for(int i = 0; i < scope_cnt; i++)
+    {
+        settings.setArrayIndex(i);
+        auto const * node = identities.value(settings.value("certificate").toByteArray());
+        if(node == nullptr)
+            continue;
+
+        QUrl const url = settings.value("url").toUrl();
+        auto const path = url.path().isEmpty() ? QString("/") : url.path();
+        this->scopes[scopeKey(url)].append(IdentityScope { path, CryptoIdentity { }, node });
+    }
+    settings.endArray();
+
+    for(auto & list : this->scopes)
+    {
+        std::stable_sort(list.begin(), list.end(), [](IdentityScope const & a, IdentityScope const & b) {
+            return a.path_prefix.length() > b.path_prefix.length();
+        });
+    }
+
     relayout();
 
     this->endResetModel();
@@ -82,8 +136,9 @@ void IdentityCollection::save(QSettings &settings) const
             auto & id = _id->as<IdentityNode>();
 
             settings.setValue("display_name",  id.identity.display_name);
-            settings.setValue("certificate", id.identity.certificate.toDer());
-            settings.setValue("private_key", id.identity.private_key.toDer());
+            settings.setValue("certificate", id.certificate_der);
+            settings.setValue("private_key", id.private_key_der);
+            settings.setValue("key_type", (id.key_algorithm == QSsl::Ec) ? "ec" : "rsa");
         }
 
 
@@ -91,6 +146,24 @@ void IdentityCollection::save(QSettings &settings) const
     }
 
     settings.endArray();
+
+    // Only scopes of persistent identities survive a restart
+    settings.beginWriteArray("scopes");
+    int scope_index = 0;
+    for(auto it = scopes.begin(); it != scopes.end(); ++it)
+    {
+        for(auto const & scope : it.value())
+        {
+            if(scope.node == nullptr and not scope.identity.is_persistent)
+                continue;
+            settings.setArrayIndex(scope_index);
+            scope_index += 1;
+
+            settings.setValue("url", QUrl("gemini://" + it.key() + scope.path_prefix));
+            settings.setValue("certificate", fingerprint((scope.node != nullptr) ? scope.node->certificate_der : scope.identity.certificate.toDer()));
+        }
+    }
+    settings.endArray();
 }
 
 bool IdentityCollection::addCertificate(const QString &group_name, const CryptoIdentity &crypto_id)
@@ -118,6 +191,10 @@ bool IdentityCollection::addCertificate(const QString &group_name, const CryptoI
 
     auto id = std::make_unique<IdentityNode>();
     id->identity = crypto_id;
+    id->is_decoded = true;
+    id->certificate_der = crypto_id.certificate.toDer();
+    id->private_key_der = crypto_id.private_key.toDer();
+    id->key_algorithm = crypto_id.private_key.algorithm();
     group->children.emplace_back(std::move(id));
 
     this->relayout();
@@ -137,7 +214,7 @@ CryptoIdentity IdentityCollection::getIdentity(const QModelIndex &index) const
 
     Node const *item = static_cast<Node const*>(index.internalPointer());
     switch(item->type) {
-    case Node::Identity: return static_cast<IdentityNode const *>(item)->identity;
+    case Node::Identity: return static_cast<IdentityNode const *>(item)->decoded();
     default:
         return CryptoIdentity();
     }
@@ -153,6 +230,135 @@ QStringList IdentityCollection::groups() const
     return result;
 }
 
+void IdentityCollection::addScope(const QUrl &url, const CryptoIdentity &id)
+{
+    if(not id.isValid() or not id.is_persistent)
+        return;
+
+    auto const path = url.path().isEmpty() ? QString("/") : url.path();
+
+    auto & list = this->scopes[scopeKey(url)];
+    for(int i = list.size() - 1; i >= 0; i--)
+    {
+        if(list[i].path_prefix == path)
+            list.removeAt(i);
+    }
+
+    auto it = std::find_if(list.begin(), list.end(), [&](IdentityScope const & scope) {
+        return scope.path_prefix.length() < path.length();
+    });
+    list.insert(it, IdentityScope { path, id });
+}
+
+void IdentityCollection::removeScopes(const QUrl &url)
+{
+    auto it = this->scopes.find(scopeKey(url));
+    if(it == this->scopes.end())
+        return;
+
+    auto const path = url.path().isEmpty() ? QString("/") : url.path();
+
+    auto & list = it.value();
+    for(int i = list.size() - 1; i >= 0; i--)
+    {
+        if(isInScope(path, list[i].path_prefix))
+            list.removeAt(i);
+    }
+    if(list.isEmpty())
+        this->scopes.erase(it);
+}
+
+void IdentityCollection::removeScopes(const CryptoIdentity &id)
+{
+    for(auto it = this->scopes.begin(); it != this->scopes.end(); )
+    {
+        auto & list = it.value();
+        for(int i = list.size() - 1; i >= 0; i--)
+        {
+            if(list[i].get().certificate == id.certificate)
+                list.removeAt(i);
+        }
+        if(list.isEmpty())
+            it = this->scopes.erase(it);
+        else
+            ++it;
+    }
+}
+
+CryptoIdentity IdentityCollection::findScopedIdentity(const QUrl &url) const
+{
+    auto it = this->scopes.find(scopeKey(url));
+    if(it == this->scopes.end())
+        return CryptoIdentity { };
+
+    auto const path = url.path().isEmpty() ? QString("/") : url.path();
+    auto const now = QDateTime::currentDateTime();
+
+    for(auto const & scope : it.value())
+    {
+        if(not isInScope(path, scope.path_prefix))
+            continue;
+        // Transient identities time out, more general scopes may still apply
+        auto const & identity = scope.get();
+        if(identity.certificate.expiryDate() < now)
+            continue;
+        return identity;
+    }
+    return CryptoIdentity { };
+}
+
+QString IdentityCollection::scopeKey(const QUrl &url)
+{
+    return QString("%1:%2").arg(url.host().toLower()).arg(url.port(1965));
+}
+
+bool IdentityCollection::isInScope(const QUrl &url, const QUrl &scope)
+{
+    if(scopeKey(url) != scopeKey(scope))
+        return false;
+    return isInScope(
+        url.path().isEmpty() ? QString("/") : url.path(),
+        scope.path().isEmpty() ? QString("/") : scope.path());
+}
+
+bool IdentityCollection::isInScope(const QString &path, const QString &prefix)
+{
+    if(not path.startsWith(prefix))
+        return false;
+    return (path.size() == prefix.size())
+        or prefix.endsWith('/')
+        or (path.at(prefix.size()) == '/');
+}
+
+qint64 IdentityCollection::estimateMemoryUsage() const
+{
+    qint64 size = 0;
+    for(auto const & grp : root.children)
+    {
+        size += sizeof(GroupNode);
+        for(auto const & _id : grp->children)
+        {
+            auto const & id = _id->as<IdentityNode>();
+            size += sizeof(IdentityNode);
+            size += id.certificate_der.size() + id.private_key_der.size();
+            if(id.is_decoded) {
+                // OpenSSL keeps its own copy of the decoded key material
+                size += id.certificate_der.size() + id.private_key_der.size();
+            }
+            size += sizeof(QChar) * id.identity.display_name.size();
+        }
+    }
+    for(auto it = scopes.begin(); it != scopes.end(); ++it)
+    {
+        size += sizeof(QChar) * it.key().size();
+        for(auto const & scope : it.value())
+        {
+            size += sizeof(IdentityScope) + sizeof(QChar) * scope.path_prefix.size();
+        }
+    }
+    return size;
+}
+
 QModelIndex IdentityCollection::index(int row, int column, const QModelIndex &parent) const
 {
     if (not hasIndex(row, column, parent))
@@ -6,6 +6,9 @@
 #include <QAbstractItemModel>
 #include <memory>
 #include <QSettings>
+#include <QHash>
+#include <QVector>
+#include <QUrl>
 
 class IdentityCollection : public QAbstractItemModel
 {
@@ -24,9 +27,20 @@ class IdentityCollection : public QAbstractItemModel
     };
 
     struct IdentityNode : Node {
-        CryptoIdentity identity;
+        //! Holds the display name right away, the key material
+        //! only after decoded() was called.
+        mutable CryptoIdentity identity;
+        mutable bool is_decoded = false;
+
+        QByteArray certificate_der;
+        QByteArray private_key_der;
+        QSsl::KeyAlgorithm key_algorithm = QSsl::Rsa;
+
         IdentityNode() : Node(Identity) { }
         ~IdentityNode() override = default;
+
+        //! Decodes the certificate and key on first use.
+        CryptoIdentity const & decoded() const;
     };
 
     struct GroupNode : Node {
@@ -40,6 +54,20 @@ class IdentityCollection : public QAbstractItemModel
         ~RootNode() override = default;
     };
 
+    //! An identity that is sent to all URLs of a host whose path is
+    //! `path_prefix` or lies below it.
+    struct IdentityScope {
+        QString path_prefix;
+        CryptoIdentity identity;
+        //! Set for scopes loaded from the settings, so the identity
+        //! is only decoded when the scope is used.
+        IdentityNode const * node = nullptr;
+
+        CryptoIdentity const & get() const {
+            return (node != nullptr) ? node->decoded() : identity;
+        }
+    };
+
 public:
     explicit IdentityCollection(QObject *parent = nullptr);
 
@@ -54,6 +82,28 @@ public:
 
     QStringList groups() const;
 
+    //! Binds `id` to the host of `url`, the path of `url` and all paths
+    //! below it. Transient identities are not shared between tabs, so
+    //! they are scoped by the tab that uses them instead.
+    void addScope(QUrl const & url, CryptoIdentity const & id);
+
+    //! Removes all scopes that contain `url`.
+    void removeScopes(QUrl const & url);
+
+    //! Removes all scopes bound to `id`.
+    void removeScopes(CryptoIdentity const & id);
+
+    //! Returns the identity of the most specific scope containing `url`
+    //! or an invalid identity if there is none.
+    CryptoIdentity findScopedIdentity(QUrl const & url) const;
+
+    //! Returns true if `url` is on the host of `scope` and its path is
+    //! the path of `scope` or below it.
+    static bool isInScope(QUrl const & url, QUrl const & scope);
+
+    //! Rough estimate of the memory used by all identities in bytes.
+    qint64 estimateMemoryUsage() const;
+
 public:
     // Header:
     // QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
@@ -71,8 +121,18 @@ public:
 private:
     void relayout();
 
+    static QString scopeKey(QUrl const & url);
+
+    //! Returns true if `path` is `prefix` or a path below it. A prefix
+    //! without a trailing '/' doesn't match its siblings, so "/app"
+    //! contains "/app/login" but not "/apple".
+    static bool isInScope(QString const & path, QString const & prefix);
+
 private:
     RootNode root;
+
+    //! Scopes per host and port, most specific path prefix first
+    QHash<QString, QVector<IdentityScope>> scopes;
 };
 
 #endif // IDENTITYCOLLECTION_HPP
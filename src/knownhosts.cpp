@@ -0,0 +1,167 @@
+#include "knownhosts.hpp"
+
+#include <algorithm>
+#include <QUrl>
+#include <QFile>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QMutexLocker>
+#include <QStringList>
+#include <QCryptographicHash>
+#include <QDebug>
+
+static quint32 const file_magic = 0x4B484F53; // "KHOS"
+static quint32 const file_version = 1;
+
+KnownHosts::Result KnownHosts::verify(const QString &host, int port, const QSslCertificate &certificate)
+{
+    QMutexLocker lock { &this->mutex };
+    auto const fingerprint = certificate.digest(QCryptographicHash::Sha256);
+    auto const now = QDateTime::currentDateTimeUtc();
+
+    auto it = this->hosts.find(key(host, port));
+    if(it != this->hosts.end() and it->fingerprint == fingerprint)
+        return Trusted;
+
+    Result result = NewHost;
+    if(it != this->hosts.end())
+    {
+        if(it->expiry > now)
+            return Mismatch;
+        result = Renewed;
+    }
+
+    this->hosts.insert(key(host, port), Entry { fingerprint, certificate.expiryDate().toUTC(), now });
+    this->write();
+
+    return result;
+}
+
+KnownHosts::Entry KnownHosts::entry(const QString &host, int port) const
+{
+    QMutexLocker lock { &this->mutex };
+    return this->hosts.value(key(host, port));
+}
+
+void KnownHosts::forget(const QString &key)
+{
+    QMutexLocker lock { &this->mutex };
+    if(this->hosts.remove(key) > 0)
+        this->write();
+}
+
+bool KnownHosts::load(const QString &file_name)
+{
+    QMutexLocker lock { &this->mutex };
+    this->file_name = file_name;
+    this->hosts.clear();
+
+    QFile file { file_name };
+    if(not file.open(QFile::ReadOnly))
+        return false;
+
+    QDataStream stream { &file };
+    stream.setVersion(QDataStream::Qt_5_12);
+
+    quint32 magic, version, count;
+    stream >> magic >> version >> count;
+    if(magic != file_magic or version != file_version) {
+        qWarning() << "Ignoring known hosts file with unknown format:" << file_name;
+        return false;
+    }
+
+    this->hosts.reserve(int(count));
+    for(quint32 i = 0; i < count and stream.status() == QDataStream::Ok; i++)
+    {
+        QString host;
+        Entry entry;
+        qint64 expiry, first_seen;
+        stream >> host >> entry.fingerprint >> expiry >> first_seen;
+        entry.expiry = QDateTime::fromSecsSinceEpoch(expiry, Qt::UTC);
+        entry.first_seen = QDateTime::fromSecsSinceEpoch(first_seen, Qt::UTC);
+        this->hosts.insert(host, entry);
+    }
+
+    return (stream.status() == QDataStream::Ok);
+}
+
+bool KnownHosts::save() const
+{
+    QMutexLocker lock { &this->mutex };
+    return this->write();
+}
+
+bool KnownHosts::write() const
+{
+    if(this->file_name.isEmpty())
+        return false;
+
+    QDir().mkpath(QFileInfo(this->file_name).absolutePath());
+
+    QSaveFile file { this->file_name };
+    if(not file.open(QFile::WriteOnly))
+        return false;
+
+    QDataStream stream { &file };
+    stream.setVersion(QDataStream::Qt_5_12);
+
+    stream << file_magic << file_version << quint32(this->hosts.size());
+    for(auto it = this->hosts.begin(); it != this->hosts.end(); ++it)
+    {
+        stream << it.key() << it->fingerprint << it->expiry.toSecsSinceEpoch() << it->first_seen.toSecsSinceEpoch();
+    }
+
+    return file.commit();
+}
+
+QByteArray KnownHosts::toGemini() const
+{
+    QMutexLocker lock { &this->mutex };
+    QString document;
+
+    document += "# Known Hosts\n";
+    document += "\n";
+    document += "Kristall trusts the certificate a host presents on the first visit and warns when it changes before it expires. Forget a host if it changed its certificate on purpose.\n";
+    document += "\n";
+
+    QStringList keys = this->hosts.keys();
+    std::sort(keys.begin(), keys.end());
+
+    for(auto const & key : keys)
+    {
+        auto const & entry = this->hosts[key];
+        document += "## " + key + "\n";
+        document += "```\n";
+        document += "SHA-256:    " + fingerprintString(entry.fingerprint) + "\n";
+        document += "First seen: " + entry.first_seen.toLocalTime().toString(Qt::ISODate) + "\n";
+        document += "Expires:    " + entry.expiry.toLocalTime().toString(Qt::ISODate) + "\n";
+        document += "```\n";
+        document += QString("=> about:known-hosts?forget=%1 Forget %2\n").arg(QString::fromLatin1(QUrl::toPercentEncoding(key))).arg(key);
+        document += "\n";
+    }
+
+    return document.toUtf8();
+}
+
+qint64 KnownHosts::estimateMemoryUsage() const
+{
+    QMutexLocker lock { &this->mutex };
+    qint64 size = 0;
+    for(auto it = this->hosts.begin(); it != this->hosts.end(); ++it)
+    {
+        size += sizeof(Entry) + sizeof(QChar) * it.key().size() + it->fingerprint.size();
+    }
+    return size;
+}
+
+QString KnownHosts::fingerprintString(const QByteArray &fingerprint)
+{
+    return QString::fromLatin1(fingerprint.toHex(':')).toUpper();
+}
+
+QString KnownHosts::key(const QString &host, int port)
+{
+    return QString("%1:%2").arg(host.toLower()).arg(port);
+}
@@ -0,0 +1,65 @@
+#ifndef KNOWNHOSTS_HPP
+#define KNOWNHOSTS_HPP
+
+#include <QHash>
+#include <QString>
+#include <QDateTime>
+#include <QByteArray>
+#include <QSslCertificate>
+#include <QMutex>
+
+//! Trust-on-first-use store that pins the certificate fingerprint
+//! of each host and port. Lookups are a single hash access and one
+//! fingerprint comparison, no certificate chain is validated.
+//! All functions are thread-safe, hosts are verified on the network thread.
+class KnownHosts
+{
+public:
+    enum Result {
+        Trusted,  //!< The fingerprint matches the pinned one
+        NewHost,  //!< The host was unknown and is now pinned
+        Renewed,  //!< The pinned certificate expired and was replaced
+        Mismatch, //!< The fingerprint differs from the pinned, still valid one
+    };
+
+    struct Entry
+    {
+        QByteArray fingerprint; //!< SHA-256 over the DER encoded certificate
+        QDateTime expiry;
+        QDateTime first_seen;
+    };
+
+    //! Checks `certificate` against the pinned one. Unknown hosts and
+    //! hosts whose pinned certificate expired are pinned to `certificate`.
+    Result verify(QString const & host, int port, QSslCertificate const & certificate);
+
+    //! Returns the pinned entry or an entry with an empty fingerprint.
+    Entry entry(QString const & host, int port) const;
+
+    //! Removes the entry for `key` ("host:port").
+    void forget(QString const & key);
+
+    //! Loads the store from `file_name` and saves all changes back to it.
+    bool load(QString const & file_name);
+
+    bool save() const;
+
+    //! Renders all pinned hosts as a text/gemini page.
+    QByteArray toGemini() const;
+
+    qint64 estimateMemoryUsage() const;
+
+    static QString fingerprintString(QByteArray const & fingerprint);
+
+private:
+    static QString key(QString const & host, int port);
+
+    bool write() const;
+
+private:
+    mutable QMutex mutex;
+    QString file_name;
+    QHash<QString, Entry> hosts;
+};
+
+#endif // KNOWNHOSTS_HPP
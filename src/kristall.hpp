@@ -5,9 +5,17 @@
 #include <QClipboard>
 
 #include "identitycollection.hpp"
+#include "requestlog.hpp"
+#include "knownhosts.hpp"
+#include "responsecache.hpp"
+#include "redirectcache.hpp"
 
 extern QSettings global_settings;
 extern IdentityCollection global_identities;
 extern QClipboard * global_clipboard;
+extern RequestLog global_request_log;
+extern KnownHosts global_known_hosts;
+extern ResponseCache global_response_cache;
+extern RedirectCache global_redirect_cache;
 
 #endif // KRISTALL_HPP
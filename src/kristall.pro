@@ -1,6 +1,6 @@
 QT       += core gui
 
-greaterThan(QT_MAJOR_VERSION, 4): QT += widgets network multimedia multimediawidgets
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets network multimedia multimediawidgets concurrent
 
 CONFIG += c++17
 
@@ -40,6 +40,7 @@ SOURCES += \
     certificateselectiondialog.cpp \
     cryptoidentity.cpp \
     documentoutlinemodel.cpp \
+    documentpatch.cpp \
     documentstyle.cpp \
     elidelabel.cpp \
     favouritecollection.cpp \
@@ -48,16 +49,33 @@ SOURCES += \
     geminirenderer.cpp \
     gopherclient.cpp \
     gophermaprenderer.cpp \
+    gophermirrors.cpp \
+    hostconnector.cpp \
+    iconcache.cpp \
     identitycollection.cpp \
     ioutil.cpp \
+    knownhosts.cpp \
     main.cpp \
     mainwindow.cpp \
     mediaplayer.cpp \
+    memoryreport.cpp \
+    networkaccess.cpp \
+    networkthread.cpp \
     newidentitiydialog.cpp \
     plaintextrenderer.cpp \
+    preconnector.cpp \
+    prefetcher.cpp \
     protocolsetup.cpp \
+    redirectcache.cpp \
+    renderstyle.cpp \
+    requestcoalescer.cpp \
+    requestlog.cpp \
+    requesttiming.cpp \
+    responsecache.cpp \
     settingsdialog.cpp \
+    stalldetector.cpp \
     tabbrowsinghistory.cpp \
+    tracer.cpp \
     webclient.cpp
 
 HEADERS += \
@@ -67,6 +85,7 @@ HEADERS += \
     certificateselectiondialog.hpp \
     cryptoidentity.hpp \
     documentoutlinemodel.hpp \
+    documentpatch.hpp \
     documentstyle.hpp \
     elidelabel.hpp \
     favouritecollection.hpp \
@@ -75,16 +94,33 @@ HEADERS += \
     geminirenderer.hpp \
     gopherclient.hpp \
     gophermaprenderer.hpp \
+    gophermirrors.hpp \
+    hostconnector.hpp \
+    iconcache.hpp \
     identitycollection.hpp \
     ioutil.hpp \
+    knownhosts.hpp \
     kristall.hpp \
     mainwindow.hpp \
     mediaplayer.hpp \
+    memoryreport.hpp \
+    networkaccess.hpp \
+    networkthread.hpp \
     newidentitiydialog.hpp \
     plaintextrenderer.hpp \
+    preconnector.hpp \
+    prefetcher.hpp \
     protocolsetup.hpp \
+    redirectcache.hpp \
+    renderstyle.hpp \
+    requestcoalescer.hpp \
+    requestlog.hpp \
+    requesttiming.hpp \
+    responsecache.hpp \
     settingsdialog.hpp \
+    stalldetector.hpp \
     tabbrowsinghistory.hpp \
+    tracer.hpp \
     webclient.hpp
 
 FORMS += \
@@ -1,15 +1,48 @@
 #include "mainwindow.hpp"
 #include "kristall.hpp"
+#include "tracer.hpp"
+#include "memoryreport.hpp"
+#include "stalldetector.hpp"
+#include "certificatehelper.hpp"
+#include "preconnector.hpp"
+#include "prefetcher.hpp"
+#include "networkthread.hpp"
+#include "hostconnector.hpp"
+#include "networkaccess.hpp"
+#include "geminiclient.hpp"
 
 #include <QApplication>
 #include <QUrl>
 #include <QSettings>
 #include <QCommandLineParser>
 #include <QDebug>
+#include <QTimer>
+#include <QTextStream>
+#include <QStandardPaths>
+#include <QSslSocket>
+#include <QSslConfiguration>
+#include <QtConcurrent>
 
 IdentityCollection global_identities;
 QSettings global_settings { "xqTechnologies", "Kristall" };
 QClipboard * global_clipboard;
+RequestLog global_request_log;
+KnownHosts global_known_hosts;
+ResponseCache global_response_cache;
+RedirectCache global_redirect_cache;
+
+//! Loads and initializes the TLS backend and the system CA store, so
+//! the first https:// request does not pay for it. Gemini connections
+//! don't use the system CAs at all.
+static void warmUpTls()
+{
+    TraceScope trace { "startup", "TLS warm-up" };
+    if(not QSslSocket::supportsSsl()) {
+        qWarning() << "TLS is not supported, gemini:// and https:// will not work";
+        return;
+    }
+    QSslConfiguration::defaultConfiguration().caCertificates();
+}
 
 int main(int argc, char *argv[])
 {
@@ -18,17 +51,100 @@ int main(int argc, char *argv[])
     global_clipboard = app.clipboard();
 
     QCommandLineParser cli_parser;
+
+    QCommandLineOption trace_option {
+        "trace-file",
+        "Writes Chrome trace-event JSON of navigation, network and rendering spans to <file> on exit.",
+        "file"
+    };
+    cli_parser.addOption(trace_option);
+
+    QCommandLineOption memory_report_option {
+        "memory-report",
+        "Prints the about:memory report to stdout after <seconds> and quits. Use with -platform offscreen to run headless.",
+        "seconds"
+    };
+    cli_parser.addOption(memory_report_option);
+
+    QCommandLineOption stall_option {
+        "stall-threshold",
+        "Logs every stall of the user interface longer than <ms> milliseconds and lists them on about:stalls.",
+        "ms"
+    };
+    cli_parser.addOption(stall_option);
+
     cli_parser.parse(app.arguments());
 
+    if(cli_parser.isSet(trace_option)) {
+        Tracer::start(cli_parser.value(trace_option));
+        // Runs when the application object is destroyed, after the main window saved its settings
+        qAddPostRoutine([]() {
+            Tracer::finish();
+        });
+    }
+
+    // Runs in parallel with loading the settings and creating the main window
+    QtConcurrent::run(warmUpTls);
+
+    // Gemini failures are queued from the network thread to the tabs
+    qRegisterMetaType<TemporaryFailure>();
+    qRegisterMetaType<PermanentFailure>();
+    qRegisterMetaType<CertificateRejection>();
+
     if(not global_settings.contains("start_page")) {
         global_settings.setValue("start_page", "about:favourites");
     }
 
+    global_request_log.setCapacity(global_settings.value("network_log_size", 200).toInt());
+
+    Preconnector::setLimits(
+        global_settings.value("preconnect_per_host", 1).toInt(),
+        global_settings.value("preconnect_max", 6).toInt(),
+        1000 * global_settings.value("preconnect_idle_timeout", 10).toInt());
+
+    NetworkTimeouts::set(
+        1000 * global_settings.value("connect_timeout", 10).toInt(),
+        1000 * global_settings.value("handshake_timeout", 10).toInt(),
+        1000 * global_settings.value("first_byte_timeout", 30).toInt(),
+        1000 * global_settings.value("idle_timeout", 30).toInt(),
+        global_settings.value("connection_attempt_delay", 250).toInt());
+
+    NetworkAccess::setLimits(
+        QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/web",
+        1024 * 1024 * global_settings.value("web_cache_size", 50).toLongLong(),
+        global_settings.value("web_connections_per_host", 6).toInt());
+
+    Prefetcher::setLimits(
+        global_settings.value("prefetch_links", 4).toInt(),
+        global_settings.value("prefetch_connections", 1).toInt(),
+        1024 * global_settings.value("prefetch_budget", 512).toLongLong());
+    global_response_cache.setLimits(
+        1024 * global_settings.value("prefetch_cache_size", 4096).toLongLong(),
+        global_settings.value("prefetch_max_age", 300).toInt());
+
+    global_redirect_cache.setFailureLifetime(global_settings.value("failure_cache_lifetime", 600).toInt());
+
+    // The limits above are read on the network thread without locking,
+    // starting the thread publishes them
+    NetworkThread::start();
+
+    StallDetector::start(cli_parser.isSet(stall_option)
+        ? cli_parser.value(stall_option).toInt()
+        : global_settings.value("stall_threshold", 0).toInt());
+
+    global_known_hosts.load(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/known_hosts");
+    global_redirect_cache.load(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/redirects");
+
     global_settings.beginGroup("Client Identities");
-    global_identities.load(global_settings);
+    {
+        StallScope stall { "IdentityCollection::load" };
+        global_identities.load(global_settings);
+    }
     global_settings.endGroup();
 
+    qint64 const window_begin = RequestTiming::now();
     MainWindow w(&app);
+    Tracer::addSpan("startup", "MainWindow construction", window_begin, RequestTiming::now());
 
     auto urls = cli_parser.positionalArguments();
     if(urls.size() > 0) {
@@ -46,5 +162,15 @@ int main(int argc, char *argv[])
     }
     w.show();
 
+    CertificateHelper::fillTransientKeyPool();
+
+    if(cli_parser.isSet(memory_report_option)) {
+        int const delay = cli_parser.value(memory_report_option).toInt();
+        QTimer::singleShot(1000 * delay, &w, [&w]() {
+            QTextStream(stdout) << MemoryReport::toGemini(w.tabs());
+            QApplication::quit();
+        });
+    }
+
     return app.exec();
 }
@@ -12,6 +12,10 @@
 #include <QFileDialog>
 #include "ioutil.hpp"
 #include "kristall.hpp"
+#include "tracer.hpp"
+#include "stalldetector.hpp"
+#include "iconcache.hpp"
+#include "renderstyle.hpp"
 
 
 MainWindow::MainWindow(QApplication * app, QWidget *parent) :
@@ -143,8 +147,33 @@ void MainWindow::setUrlPreview(const QUrl &url)
     }
 }
 
+QVector<BrowserTab *> MainWindow::tabs() const
+{
+    QVector<BrowserTab *> result;
+    for(int i = 0; i < this->ui->browser_tabs->count(); i++)
+    {
+        if(auto * tab = qobject_cast<BrowserTab*>(this->ui->browser_tabs->widget(i)); tab != nullptr) {
+            result.append(tab);
+        }
+    }
+    return result;
+}
+
+void MainWindow::hibernateBackgroundTabs()
+{
+    for(auto * tab : this->tabs())
+    {
+        if(tab != this->ui->browser_tabs->currentWidget()) {
+            tab->hibernate();
+        }
+    }
+}
+
 void MainWindow::saveSettings()
 {
+    TraceScope trace { "settings", "MainWindow::saveSettings" };
+    StallScope stall { "MainWindow::saveSettings" };
+
     this->favourites.save(global_settings);
     this->protocols.save(global_settings);
 
@@ -174,6 +203,9 @@ void MainWindow::on_browser_tabs_currentChanged(int index)
         BrowserTab * tab = qobject_cast<BrowserTab*>(this->ui->browser_tabs->widget(index));
 
         if(tab != nullptr) {
+            tab->wakeUp();
+            tab->restyle();
+
             this->ui->outline_view->setModel(&tab->outline);
             this->ui->outline_view->expandAll();
 
@@ -262,7 +294,14 @@ void MainWindow::on_actionSettings_triggered()
     this->current_style = dialog.geminiStyle();
     this->saveSettings();
 
+    IconCache::invalidate();
+    StyleCache::invalidate();
     this->reloadTheme();
+
+    // Background tabs are restyled when they are shown
+    if(auto * tab = qobject_cast<BrowserTab*>(this->ui->browser_tabs->currentWidget())) {
+        tab->restyle();
+    }
 }
 
 void MainWindow::on_actionNew_Tab_triggered()
@@ -398,6 +437,7 @@ void MainWindow::on_tab_fileLoaded(qint64 fileSize, const QString &mime, int mse
             this->file_size->setText(IoUtil::size_human(fileSize));
             this->file_mime->setText(mime);
             this->load_time->setText(QString("%1 ms").arg(msec));
+            this->load_time->setToolTip(tab->timing.toString());
         }
     }
 }
@@ -4,6 +4,7 @@
 #include <QMainWindow>
 #include <QLabel>
 #include <QSettings>
+#include <QVector>
 
 
 #include "favouritecollection.hpp"
@@ -31,6 +32,11 @@ public:
 
     void setUrlPreview(QUrl const & url);
 
+    QVector<BrowserTab *> tabs() const;
+
+    //! Hibernates all tabs except the current one.
+    void hibernateBackgroundTabs();
+
     void saveSettings();
 
 public:
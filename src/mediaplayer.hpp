@@ -20,6 +20,11 @@ public:
 
     void setMedia(QByteArray const & data, QUrl const & ref_url, QString const & mime);
 
+    //! Size of the buffered media file in bytes.
+    qint64 bufferSize() const {
+        return media_stream.data().size();
+    }
+
 private slots:
     void on_playpause_button_clicked();
 
@@ -0,0 +1,165 @@
+#include "memoryreport.hpp"
+#include "browsertab.hpp"
+#include "ioutil.hpp"
+#include "kristall.hpp"
+#include "iconcache.hpp"
+#include "gophermirrors.hpp"
+
+#include <algorithm>
+#include <QMap>
+#include <QPair>
+#include <QPixmapCache>
+#include <QTextDocument>
+
+static QMap<QString, qint64> peaks;
+
+static void updatePeak(QString const & name, qint64 value)
+{
+    auto & peak = peaks[name];
+    peak = std::max(peak, value);
+}
+
+static TabMemoryUsage sumTabs(QVector<BrowserTab *> const & tabs)
+{
+    TabMemoryUsage sum;
+    for(auto const * tab : tabs)
+    {
+        auto const usage = tab->memoryUsage();
+        sum.buffer += usage.buffer;
+        sum.hibernated += usage.hibernated;
+        sum.document += usage.document;
+        sum.images += usage.images;
+        sum.media += usage.media;
+        sum.outline += usage.outline;
+        sum.history += usage.history;
+    }
+    return sum;
+}
+
+static QVector<QPair<QString, qint64>> subsystems(TabMemoryUsage const & tabs)
+{
+    return {
+        { "Page buffers", tabs.buffer },
+        { "Hibernated pages", tabs.hibernated },
+        { "Documents", tabs.document },
+        { "Images", tabs.images },
+        { "Media buffers", tabs.media },
+        { "Outlines", tabs.outline },
+        { "Histories", tabs.history },
+        { "Identities", global_identities.estimateMemoryUsage() },
+        { "Request log", global_request_log.estimateMemoryUsage() },
+        { "Known hosts", global_known_hosts.estimateMemoryUsage() },
+        { "Response cache", global_response_cache.estimateMemoryUsage() },
+        { "Redirects", global_redirect_cache.estimateMemoryUsage() },
+        { "Icons", IconCache::estimateMemoryUsage() },
+        { "Gopher mirrors", GopherMirrors::estimateMemoryUsage() },
+    };
+}
+
+QByteArray MemoryReport::toGemini(QVector<BrowserTab *> const & tabs)
+{
+    auto const sum = sumTabs(tabs);
+    auto const items = subsystems(sum);
+
+    qint64 total = 0;
+    for(auto const & item : items) {
+        updatePeak(item.first, item.second);
+        total += item.second;
+    }
+    updatePeak("Total", total);
+
+    QString document;
+
+    document += "# Memory\n";
+    document += "\n";
+    document += "Estimated memory held by Kristall. The numbers are approximations and do not include Qt, fonts or system libraries.\n";
+    document += "\n";
+    document += "=> about:memory Refresh\n";
+    document += "=> about:memory?hibernate Hibernate all background tabs\n";
+    document += "=> about:memory?trim Trim caches\n";
+    document += "\n";
+    document += "## Tabs\n";
+    document += "\n";
+    document += "```\n";
+    document += QString("%1 %2 %3 %4 %5 %6 %7 %8  %9\n")
+        .arg("Tab", 3)
+        .arg("Buffer", 10)
+        .arg("Document", 10)
+        .arg("Images", 10)
+        .arg("Media", 10)
+        .arg("Outline", 10)
+        .arg("History", 10)
+        .arg("Total", 10)
+        .arg("URL");
+
+    for(auto const * tab : tabs)
+    {
+        auto const usage = tab->memoryUsage();
+        document += QString("%1 %2 %3 %4 %5 %6 %7 %8  %9\n")
+            .arg(tab->tab_id, 3)
+            .arg(IoUtil::size_human(usage.buffer + usage.hibernated), 10)
+            .arg(IoUtil::size_human(usage.document), 10)
+            .arg(IoUtil::size_human(usage.images), 10)
+            .arg(IoUtil::size_human(usage.media), 10)
+            .arg(IoUtil::size_human(usage.outline), 10)
+            .arg(IoUtil::size_human(usage.history), 10)
+            .arg(IoUtil::size_human(usage.total()), 10)
+            .arg((tab->is_hibernated ? "(hibernated) " : "") + tab->current_location.toString());
+    }
+    document += "```\n";
+    document += "\n";
+    document += "## Subsystems\n";
+    document += "\n";
+    document += "```\n";
+    document += QString("%1 %2 %3\n")
+        .arg("Subsystem", -18)
+        .arg("Current", 10)
+        .arg("Peak", 10);
+
+    for(auto const & item : items)
+    {
+        document += QString("%1 %2 %3\n")
+            .arg(item.first, -18)
+            .arg(IoUtil::size_human(item.second), 10)
+            .arg(IoUtil::size_human(peaks.value(item.first)), 10);
+    }
+    document += QString("%1 %2 %3\n")
+        .arg("Total", -18)
+        .arg(IoUtil::size_human(total), 10)
+        .arg(IoUtil::size_human(peaks.value("Total")), 10);
+    document += "```\n";
+
+    return document.toUtf8();
+}
+
+void MemoryReport::sampleTabs(QVector<BrowserTab *> const & tabs)
+{
+    auto const sum = sumTabs(tabs);
+    updatePeak("Page buffers", sum.buffer);
+    updatePeak("Hibernated pages", sum.hibernated);
+    updatePeak("Documents", sum.document);
+    updatePeak("Images", sum.images);
+    updatePeak("Media buffers", sum.media);
+    updatePeak("Outlines", sum.outline);
+    updatePeak("Histories", sum.history);
+}
+
+void MemoryReport::trimCaches()
+{
+    QPixmapCache::clear();
+    global_response_cache.clear();
+    global_redirect_cache.clearFailures();
+}
+
+qint64 MemoryReport::estimateDocument(QTextDocument const * document)
+{
+    if(document == nullptr)
+        return 0;
+
+    qint64 size = sizeof(QTextDocument);
+    size += sizeof(QChar) * qint64(document->characterCount());
+    // Block data, text layouts and line information
+    size += 256 * qint64(document->blockCount());
+    size += 64 * qint64(document->allFormats().size());
+    return size;
+}
@@ -0,0 +1,46 @@
+#ifndef MEMORYREPORT_HPP
+#define MEMORYREPORT_HPP
+
+#include <QVector>
+#include <QByteArray>
+
+class BrowserTab;
+class QTextDocument;
+
+//! Estimated memory usage of a single tab in bytes.
+struct TabMemoryUsage
+{
+    qint64 buffer = 0;
+    qint64 hibernated = 0;
+    qint64 document = 0;
+    qint64 images = 0;
+    qint64 media = 0;
+    qint64 outline = 0;
+    qint64 history = 0;
+
+    qint64 total() const {
+        return buffer + hibernated + document + images + media + outline + history;
+    }
+};
+
+//! Collects memory estimates of all tabs and global subsystems
+//! and renders them for about:memory.
+struct MemoryReport
+{
+    MemoryReport() = delete;
+
+    //! Renders a text/gemini report for the given tabs, including
+    //! global subsystems, totals and peaks.
+    static QByteArray toGemini(QVector<BrowserTab *> const & tabs);
+
+    //! Updates the peak values of the per-tab subsystems.
+    static void sampleTabs(QVector<BrowserTab *> const & tabs);
+
+    //! Drops all data that is cached and can be rebuilt on demand.
+    static void trimCaches();
+
+    //! Rough estimate of the memory used by `document` in bytes.
+    static qint64 estimateDocument(QTextDocument const * document);
+};
+
+#endif // MEMORYREPORT_HPP
@@ -0,0 +1,130 @@
+#include "networkaccess.hpp"
+
+#include <QNetworkAccessManager>
+#include <QNetworkDiskCache>
+#include <QPointer>
+#include <QThread>
+#include <QHash>
+#include <QList>
+
+namespace
+{
+    struct PendingRequest
+    {
+        QNetworkRequest request;
+        QPointer<QObject> context;
+        std::function<void(QNetworkReply*)> started;
+    };
+}
+
+// Set on the GUI thread before NetworkThread::start(), read on the network thread
+static QString cache_directory;
+static qint64 max_cache_size = 50 * 1024 * 1024;
+static int max_per_host = 6;
+
+static QNetworkAccessManager * manager = nullptr;
+static QHash<QString, int> running_requests;
+static QHash<QString, QList<PendingRequest>> pending_requests;
+
+static QNetworkAccessManager * instance()
+{
+    if(manager != nullptr)
+        return manager;
+
+    manager = new QNetworkAccessManager();
+    manager->setRedirectPolicy(QNetworkRequest::NoLessSafeRedirectPolicy);
+
+    if(max_cache_size > 0 and not cache_directory.isEmpty())
+    {
+        auto * cache = new QNetworkDiskCache(manager);
+        cache->setCacheDirectory(cache_directory);
+        cache->setMaximumCacheSize(max_cache_size);
+        manager->setCache(cache);
+    }
+
+    // The manager must be deleted on the thread it was created on
+    QObject::connect(QThread::currentThread(), &QThread::finished, []() {
+        delete manager;
+        manager = nullptr;
+        running_requests.clear();
+        pending_requests.clear();
+    });
+
+    return manager;
+}
+
+static QString hostKey(QUrl const & url)
+{
+    return url.scheme() + "://" + url.host() + ":" + QString::number(url.port(url.scheme() == "https" ? 443 : 80));
+}
+
+static void finish(QString const & key);
+
+static void send(QString const & key, PendingRequest const & pending)
+{
+    running_requests[key] += 1;
+
+    auto * reply = instance()->get(pending.request);
+    QObject::connect(reply, &QNetworkReply::finished, instance(), [key]() {
+        finish(key);
+    });
+
+    pending.started(reply);
+}
+
+static void finish(QString const & key)
+{
+    int const running = running_requests.value(key) - 1;
+    if(running > 0)
+        running_requests.insert(key, running);
+    else
+        running_requests.remove(key);
+
+    auto queue = pending_requests.take(key);
+    while(not queue.isEmpty() and running_requests.value(key) < max_per_host)
+    {
+        auto const next = queue.takeFirst();
+        if(not next.context.isNull())
+            send(key, next);
+    }
+    if(not queue.isEmpty())
+        pending_requests.insert(key, queue);
+}
+
+void NetworkAccess::setLimits(const QString &directory, qint64 cache_size, int per_host)
+{
+    cache_directory = directory;
+    max_cache_size = cache_size;
+    max_per_host = qMax(1, per_host);
+}
+
+void NetworkAccess::get(QNetworkRequest request, QObject *context, const std::function<void (QNetworkReply *)> &started)
+{
+    request.setAttribute(QNetworkRequest::Http2AllowedAttribute, true);
+
+    auto const key = hostKey(request.url());
+    PendingRequest pending { request, context, started };
+
+    if(running_requests.value(key) < max_per_host)
+        send(key, pending);
+    else
+        pending_requests[key].append(pending);
+}
+
+void NetworkAccess::cancel(QObject *context)
+{
+    for(auto it = pending_requests.begin(); it != pending_requests.end(); )
+    {
+        auto & queue = it.value();
+        for(int i = queue.size() - 1; i >= 0; i--)
+        {
+            if(queue[i].context.isNull() or queue[i].context == context)
+                queue.removeAt(i);
+        }
+
+        if(queue.isEmpty())
+            it = pending_requests.erase(it);
+        else
+            ++it;
+    }
+}
@@ -0,0 +1,31 @@
+#ifndef NETWORKACCESS_HPP
+#define NETWORKACCESS_HPP
+
+#include <QObject>
+#include <QString>
+#include <QNetworkRequest>
+#include <QNetworkReply>
+#include <functional>
+
+//! The QNetworkAccessManager shared by all web clients, so connections,
+//! DNS results and TLS sessions are reused between tabs. It lives on the
+//! network thread, so all functions except setLimits must be called there.
+struct NetworkAccess
+{
+    NetworkAccess() = delete;
+
+    //! Sets the size of the disk cache in `cache_directory` (0 disables it)
+    //! and the maximum number of requests running per host at the same time.
+    //! Must be called before the first request.
+    static void setLimits(QString const & cache_directory, qint64 cache_size, int per_host);
+
+    //! Sends `request` as soon as fewer than the per-host limit of requests
+    //! to its host are running and passes the reply to `started`. `context`
+    //! owns the reply and can drop the request with cancel() before that.
+    static void get(QNetworkRequest request, QObject * context, std::function<void(QNetworkReply*)> const & started);
+
+    //! Drops all requests of `context` that are still waiting for a connection.
+    static void cancel(QObject * context);
+};
+
+#endif // NETWORKACCESS_HPP
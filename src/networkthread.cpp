@@ -0,0 +1,49 @@
+#include "networkthread.hpp"
+
+#include <QCoreApplication>
+
+static QThread * network_thread = nullptr;
+
+void NetworkThread::start()
+{
+    if(network_thread != nullptr)
+        return;
+
+    network_thread = new QThread();
+    network_thread->setObjectName("network");
+    network_thread->start();
+
+    qAddPostRoutine(NetworkThread::stop);
+}
+
+void NetworkThread::stop()
+{
+    if(network_thread == nullptr)
+        return;
+
+    network_thread->quit();
+    network_thread->wait();
+
+    delete network_thread;
+    network_thread = nullptr;
+}
+
+QThread * NetworkThread::instance()
+{
+    return network_thread;
+}
+
+void NetworkThread::adopt(QObject *object)
+{
+    if(network_thread != nullptr)
+        object->moveToThread(network_thread);
+}
+
+void NetworkThread::invokeBlocking(QObject *context, const std::function<void ()> &function)
+{
+    // A blocking queued call to the own thread would never return
+    if(context->thread() == QThread::currentThread())
+        function();
+    else
+        QMetaObject::invokeMethod(context, function, Qt::BlockingQueuedConnection);
+}
@@ -0,0 +1,31 @@
+#ifndef NETWORKTHREAD_HPP
+#define NETWORKTHREAD_HPP
+
+#include <QThread>
+#include <functional>
+
+//! The thread that runs all sockets of the protocol clients, so reading
+//! from the network is never blocked by layouting or rendering on the GUI
+//! thread. Clients are moved there after construction, their public methods
+//! may be called from the GUI thread and their signals are queued back.
+struct NetworkThread
+{
+    NetworkThread() = delete;
+
+    //! Starts the thread. Must be called from the GUI thread before any client is created.
+    static void start();
+
+    //! Stops the event loop of the thread and waits for it to finish.
+    static void stop();
+
+    static QThread * instance();
+
+    //! Moves `object` to the network thread. It must not have a parent.
+    //! Without a running network thread, `object` stays where it is.
+    static void adopt(QObject * object);
+
+    //! Runs `function` on the thread of `context` and returns after it finished.
+    static void invokeBlocking(QObject * context, std::function<void()> const & function);
+};
+
+#endif // NETWORKTHREAD_HPP
@@ -5,6 +5,7 @@
 #include "kristall.hpp"
 
 #include <QPushButton>
+#include <QFutureWatcher>
 #include <QDebug>
 
 NewIdentitiyDialog::NewIdentitiyDialog(QWidget *parent) :
@@ -18,6 +19,9 @@ NewIdentitiyDialog::NewIdentitiyDialog(QWidget *parent) :
     ui->expiration_date->setDate(QDate::currentDate().addYears(1));
     ui->expiration_date->setTime(QTime(12, 00));
 
+    ui->key_type->addItem("RSA (2048 bit)", CertificateHelper::RsaKey);
+    ui->key_type->addItem("ECDSA (P-256)", CertificateHelper::EcKey);
+
     ui->group->clear();
     for(auto group_name : global_identities.groups())
     {
@@ -30,14 +34,31 @@ NewIdentitiyDialog::~NewIdentitiyDialog()
     delete ui;
 }
 
-CryptoIdentity NewIdentitiyDialog::createIdentity() const
+CryptoIdentity NewIdentitiyDialog::identity() const
+{
+    return this->created_identity;
+}
+
+void NewIdentitiyDialog::accept()
 {
-    auto id = CertificateHelper::createNewIdentity(
+    this->setEnabled(false);
+    this->setCursor(Qt::BusyCursor);
+
+    auto * watcher = new QFutureWatcher<CryptoIdentity>(this);
+    connect(watcher, &QFutureWatcher<CryptoIdentity>::finished, this, [this, watcher]() {
+        this->created_identity = watcher->result();
+        this->created_identity.display_name = this->ui->display_name->text();
+        watcher->deleteLater();
+
+        this->unsetCursor();
+        this->setEnabled(true);
+        QDialog::accept();
+    });
+    watcher->setFuture(CertificateHelper::createNewIdentityAsync(
         this->ui->common_name->text(),
-        this->ui->expiration_date->dateTime()
-    );
-    id.display_name = this->ui->display_name->text();
-    return id;
+        this->ui->expiration_date->dateTime(),
+        CertificateHelper::KeyType(this->ui->key_type->currentData().toInt())
+    ));
 }
 
 QString NewIdentitiyDialog::groupName() const
@@ -17,12 +17,17 @@ public:
     explicit NewIdentitiyDialog(QWidget *parent = nullptr);
     ~NewIdentitiyDialog();
 
-    //! Creates a new identity from the currently set
-    //! user settings.
-    CryptoIdentity createIdentity() const;
+    //! Returns the identity that was created from the user
+    //! settings when the dialog was accepted.
+    CryptoIdentity identity() const;
 
     QString groupName() const;
 
+public slots:
+    //! Generates the identity on a worker thread and closes
+    //! the dialog when it is done.
+    void accept() override;
+
 private slots:
     void on_group_editTextChanged(const QString &arg1);
 
@@ -35,6 +40,8 @@ private:
 
 private:
     Ui::NewIdentitiyDialog *ui;
+
+    CryptoIdentity created_identity;
 };
 
 #endif // NEWIDENTITIYDIALOG_HPP
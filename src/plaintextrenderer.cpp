@@ -1,19 +1,24 @@
 #include "plaintextrenderer.hpp"
+#include "tracer.hpp"
 
 #include <QTextImageFormat>
 #include <QTextCursor>
 
-std::unique_ptr<QTextDocument> PlainTextRenderer::render(const QByteArray &input, const DocumentStyle &style)
+std::unique_ptr<QTextDocument> PlainTextRenderer::render(const QByteArray &input, const RenderStyle &style)
 {
-    QTextCharFormat standard;
-    standard.setFont(style.preformatted_font);
-    standard.setForeground(style.preformatted_color);
+    TraceScope trace { "render", "PlainTextRenderer::render" };
 
     std::unique_ptr<QTextDocument> result = std::make_unique<QTextDocument>();
-    result->setDocumentMargin(style.margin);
+    result->setDocumentMargin(style.style.margin);
 
-    QTextCursor cursor { result.get() };
-    cursor.insertText(QString::fromUtf8(input), standard);
+    append(*result, input, style);
 
     return result;
 }
+
+void PlainTextRenderer::append(QTextDocument &document, const QByteArray &input, const RenderStyle &style)
+{
+    QTextCursor cursor { &document };
+    cursor.movePosition(QTextCursor::End);
+    cursor.insertText(QString::fromUtf8(input), style.preformatted);
+}
@@ -1,7 +1,7 @@
 #ifndef PLAINTEXTRENDERER_HPP
 #define PLAINTEXTRENDERER_HPP
 
-#include "documentstyle.hpp"
+#include "renderstyle.hpp"
 
 #include <memory>
 #include <QTextDocument>
@@ -18,7 +18,15 @@ struct PlainTextRenderer
     //! @param outline  The extracted outline from the document
     static std::unique_ptr<QTextDocument> render(
         QByteArray const & input,
-        DocumentStyle const & style
+        RenderStyle const & style
+    );
+
+    //! Appends more of the input to a document created by `render`, so
+    //! text can be shown while it is still being received.
+    static void append(
+        QTextDocument & document,
+        QByteArray const & input,
+        RenderStyle const & style
     );
 };
 
@@ -0,0 +1,173 @@
+#include "preconnector.hpp"
+#include "geminiclient.hpp"
+#include "requesttiming.hpp"
+#include "networkthread.hpp"
+
+#include <QHash>
+#include <QList>
+#include <QTimer>
+#include <QHostInfo>
+#include <QCoreApplication>
+
+struct WarmSocket
+{
+    QSslSocket * socket;
+    //! Lives on the GUI thread and is the context of all connections to `socket`,
+    //! so no queued signal of `socket` is delivered after the timer was deleted.
+    QTimer * idle_timer;
+    bool is_encrypted;
+};
+
+static int max_per_host = 1;
+static int max_total = 6;
+static int idle_timeout = 10000;
+
+static QHash<QString, QList<WarmSocket>> warm_sockets;
+
+//! Last lookup per host in microseconds, so hovering the same link
+//! again does not start a new lookup every time.
+static QHash<QString, qint64> resolved_hosts;
+static qint64 const dns_refresh_interval = 60 * 1000 * 1000;
+
+static QString hostKey(QUrl const & url)
+{
+    return QString("%1:%2").arg(url.host().toLower()).arg(url.port(1965));
+}
+
+static WarmSocket * find(QString const & key, QSslSocket * socket)
+{
+    auto it = warm_sockets.find(key);
+    if(it == warm_sockets.end())
+        return nullptr;
+    for(auto & warm : it.value())
+    {
+        if(warm.socket == socket)
+            return &warm;
+    }
+    return nullptr;
+}
+
+static void discard(QString const & key, QSslSocket * socket)
+{
+    auto it = warm_sockets.find(key);
+    if(it == warm_sockets.end())
+        return;
+
+    auto & list = it.value();
+    for(int i = 0; i < list.size(); i++)
+    {
+        if(list[i].socket != socket)
+            continue;
+
+        auto const warm = list.takeAt(i);
+        if(list.isEmpty())
+            warm_sockets.erase(it);
+
+        // May run in a slot of the timer. The socket is closed when it
+        // is deleted on its own thread.
+        warm.idle_timer->deleteLater();
+        warm.socket->deleteLater();
+        return;
+    }
+}
+
+void Preconnector::setLimits(int per_host, int total, int idle_timeout_ms)
+{
+    max_per_host = per_host;
+    max_total = total;
+    idle_timeout = idle_timeout_ms;
+}
+
+void Preconnector::preconnect(const QUrl &url)
+{
+    if(url.scheme() != "gemini") {
+        prefetchDns(url);
+        return;
+    }
+    if(url.host().isEmpty() or not QSslSocket::supportsSsl())
+        return;
+
+    auto const key = hostKey(url);
+    if(warm_sockets.value(key).size() >= max_per_host or idleConnections() >= max_total)
+        return;
+
+    auto * socket = new QSslSocket();
+    socket->setSslConfiguration(GeminiClient::sslConfiguration());
+    NetworkThread::adopt(socket);
+
+    auto * timer = new QTimer(QCoreApplication::instance());
+    timer->setSingleShot(true);
+    QObject::connect(timer, &QTimer::timeout, timer, [key, socket]() {
+        discard(key, socket);
+    });
+    QObject::connect(socket, &QSslSocket::encrypted, timer, [key, socket]() {
+        if(auto * warm = find(key, socket); warm != nullptr)
+            warm->is_encrypted = true;
+    });
+    QObject::connect(socket, &QSslSocket::disconnected, timer, [key, socket]() {
+        discard(key, socket);
+    });
+    QObject::connect(socket, QOverload<QAbstractSocket::SocketError>::of(&QSslSocket::error), timer, [key, socket](QAbstractSocket::SocketError) {
+        discard(key, socket);
+    });
+
+    warm_sockets[key].append(WarmSocket { socket, timer, false });
+
+    timer->start(idle_timeout);
+
+    auto const host = url.host();
+    auto const port = quint16(url.port(1965));
+    QMetaObject::invokeMethod(socket, [socket, host, port]() {
+        socket->connectToHostEncrypted(host, port);
+    }, Qt::QueuedConnection);
+}
+
+void Preconnector::prefetchDns(const QUrl &url)
+{
+    auto const host = url.host().toLower();
+    if(host.isEmpty())
+        return;
+
+    auto const now = RequestTiming::now();
+    auto it = resolved_hosts.find(host);
+    if(it != resolved_hosts.end() and now - it.value() < dns_refresh_interval)
+        return;
+    resolved_hosts.insert(host, now);
+
+    QHostInfo::lookupHost(host, QCoreApplication::instance(), [](QHostInfo const &) { });
+}
+
+QSslSocket * Preconnector::take(const QUrl &url)
+{
+    auto it = warm_sockets.find(hostKey(url));
+    if(it == warm_sockets.end())
+        return nullptr;
+
+    auto & list = it.value();
+
+    // Prefer connections that finished their handshake
+    int index = 0;
+    for(int i = 0; i < list.size(); i++)
+    {
+        if(list[i].is_encrypted) {
+            index = i;
+            break;
+        }
+    }
+
+    auto const warm = list.takeAt(index);
+    if(list.isEmpty())
+        warm_sockets.erase(it);
+
+    delete warm.idle_timer;
+
+    return warm.socket;
+}
+
+int Preconnector::idleConnections()
+{
+    int count = 0;
+    for(auto const & list : warm_sockets)
+        count += list.size();
+    return count;
+}
@@ -0,0 +1,35 @@
+#ifndef PRECONNECTOR_HPP
+#define PRECONNECTOR_HPP
+
+#include <QUrl>
+#include <QSslSocket>
+
+//! Resolves hosts and opens TLS connections to gemini hosts before
+//! they are requested, e.g. when a link is hovered. A following request
+//! takes over the warm connection and skips DNS, TCP and TLS setup.
+//! All functions must be called from the GUI thread, the sockets
+//! live on the network thread.
+struct Preconnector
+{
+    Preconnector() = delete;
+
+    //! Sets the maximum number of warm connections per host and in total,
+    //! and how long a warm connection may stay unused.
+    static void setLimits(int per_host, int total, int idle_timeout_ms);
+
+    //! Resolves the host of `url` and, for gemini://, opens a warm connection.
+    static void preconnect(QUrl const & url);
+
+    //! Only resolves the host of `url`. Qt caches the result for later connections.
+    static void prefetchDns(QUrl const & url);
+
+    //! Returns a warm connection to the host of `url` or nullptr.
+    //! The connection may still be in the handshake. The caller takes ownership
+    //! and may only use the socket on the network thread.
+    static QSslSocket * take(QUrl const & url);
+
+    //! Number of warm connections that are not taken yet.
+    static int idleConnections();
+};
+
+#endif // PRECONNECTOR_HPP
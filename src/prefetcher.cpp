@@ -0,0 +1,200 @@
+#include "prefetcher.hpp"
+#include "geminiclient.hpp"
+#include "kristall.hpp"
+#include "networkthread.hpp"
+
+#include <algorithm>
+#include <QTimer>
+#include <QVector>
+#include <QCoreApplication>
+
+struct ActiveFetch
+{
+    GeminiClient * client;
+    //! Receives the signals of `client` on the GUI thread
+    QObject * context;
+    QUrl url;
+};
+
+static int max_links = 4;
+static int max_connections = 1;
+static qint64 byte_budget = 512 * 1024;
+
+//! Prefetches that don't finish in time are dropped
+static int const fetch_timeout = 15000;
+
+static QList<QUrl> queue;
+static QVector<ActiveFetch> active;
+static qint64 budget_left = 0;
+static int foreground_requests = 0;
+
+static void schedule();
+
+static bool isQueuedOrActive(QUrl const & url)
+{
+    if(queue.contains(url))
+        return true;
+    for(auto const & fetch : active) {
+        if(fetch.url == url)
+            return true;
+    }
+    return false;
+}
+
+static bool isActive(GeminiClient * client)
+{
+    for(auto const & fetch : active) {
+        if(fetch.client == client)
+            return true;
+    }
+    return false;
+}
+
+static bool isCandidate(QUrl const & url)
+{
+    if(url.scheme() != "gemini" or url.host().isEmpty())
+        return false;
+    // Queries are user input or actions of CGI scripts
+    if(url.hasQuery())
+        return false;
+    // Never send a client certificate without the user navigating there
+    if(global_identities.findScopedIdentity(url).isValid())
+        return false;
+    return not global_response_cache.contains(url);
+}
+
+static void finish(GeminiClient * client)
+{
+    for(int i = 0; i < active.size(); i++)
+    {
+        if(active[i].client != client)
+            continue;
+        auto const fetch = active.takeAt(i);
+
+        // Signals that are still queued are delivered until the
+        // context is deleted, they are ignored by isActive().
+        fetch.context->deleteLater();
+        client->disconnect();
+        client->cancelRequest();
+        client->deleteLater();
+
+        schedule();
+        return;
+    }
+}
+
+static void start(QUrl const & url)
+{
+    auto * client = new GeminiClient();
+    NetworkThread::adopt(client);
+
+    auto * context = new QObject(QCoreApplication::instance());
+    active.append(ActiveFetch { client, context, url });
+
+    QObject::connect(client, &GeminiClient::requestComplete, context, [client, url](QByteArray const & data, QString const & mime) {
+        if(not isActive(client))
+            return;
+        if(data.size() <= budget_left)
+            global_response_cache.insert(url, data, mime);
+        budget_left -= data.size();
+        finish(client);
+    });
+    QObject::connect(client, &GeminiClient::requestProgress, context, [client](qint64 transferred) {
+        if(transferred > budget_left)
+            finish(client);
+    });
+
+    // Everything else than a response body ends the prefetch
+    auto const abort = [client]() { finish(client); };
+    QObject::connect(client, &GeminiClient::protocolViolation, context, abort);
+    QObject::connect(client, &GeminiClient::inputRequired, context, abort);
+    QObject::connect(client, &GeminiClient::redirected, context, abort);
+    QObject::connect(client, &GeminiClient::temporaryFailure, context, abort);
+    QObject::connect(client, &GeminiClient::permanentFailure, context, abort);
+    QObject::connect(client, &GeminiClient::transientCertificateRequested, context, abort);
+    QObject::connect(client, &GeminiClient::authorisedCertificateRequested, context, abort);
+    QObject::connect(client, &GeminiClient::certificateRejected, context, abort);
+    QObject::connect(client, &GeminiClient::hostCertificateMismatch, context, abort);
+    QObject::connect(client, &GeminiClient::requestFailed, context, abort);
+
+    QTimer::singleShot(fetch_timeout, context, abort);
+
+    if(not client->startRequest(url))
+        finish(client);
+}
+
+static void schedule()
+{
+    while(foreground_requests == 0 and budget_left > 0 and active.size() < max_connections and not queue.isEmpty())
+    {
+        auto const url = queue.takeFirst();
+        if(isCandidate(url))
+            start(url);
+    }
+}
+
+void Prefetcher::setLimits(int links, int connections, qint64 bytes)
+{
+    max_links = links;
+    max_connections = connections;
+    byte_budget = bytes;
+    budget_left = bytes;
+}
+
+void Prefetcher::prefetchLinks(const QUrl &page, const QList<QUrl> &links)
+{
+    queue.clear();
+    budget_left = byte_budget;
+
+    for(auto const & link : links)
+    {
+        if(queue.size() >= max_links)
+            break;
+        auto const url = link.adjusted(QUrl::RemoveFragment);
+        if(url.host() != page.host() or url == page.adjusted(QUrl::RemoveFragment))
+            continue;
+        if(isCandidate(url) and not isQueuedOrActive(url))
+            queue.append(url);
+    }
+
+    schedule();
+}
+
+bool Prefetcher::prefetch(const QUrl &url)
+{
+    auto const target = url.adjusted(QUrl::RemoveFragment);
+    if(not isCandidate(target))
+        return false;
+
+    // Nothing is fetched while a tab is loading or when the budget is spent
+    if(foreground_requests > 0 or budget_left <= 0 or max_connections <= 0)
+        return false;
+
+    if(not isQueuedOrActive(target)) {
+        queue.prepend(target);
+        schedule();
+    }
+    return true;
+}
+
+void Prefetcher::beginForeground(const QUrl &url)
+{
+    foreground_requests += 1;
+
+    auto const target = url.adjusted(QUrl::RemoveFragment);
+    queue.removeAll(target);
+
+    while(not active.isEmpty())
+    {
+        auto const fetch = active.first();
+        if(fetch.url != target)
+            queue.prepend(fetch.url);
+        finish(fetch.client);
+    }
+}
+
+void Prefetcher::endForeground()
+{
+    foreground_requests = std::max(0, foreground_requests - 1);
+    schedule();
+}
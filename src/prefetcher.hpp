@@ -0,0 +1,34 @@
+#ifndef PREFETCHER_HPP
+#define PREFETCHER_HPP
+
+#include <QUrl>
+#include <QList>
+
+//! Fetches gemini pages that are likely to be opened next into
+//! `global_response_cache`. Prefetching pauses while any tab loads a
+//! page and stays within a connection and a byte budget.
+struct Prefetcher
+{
+    Prefetcher() = delete;
+
+    //! `links` same-host links are queued per page, at most
+    //! `connections` are fetched in parallel and at most
+    //! `bytes` are fetched per page.
+    static void setLimits(int links, int connections, qint64 bytes);
+
+    //! Replaces the queue with the first same-host links of `page`.
+    static void prefetchLinks(QUrl const & page, QList<QUrl> const & links);
+
+    //! Queues `url` in front of all other links. Returns false if `url`
+    //! cannot be prefetched or no prefetch can run at the moment.
+    static bool prefetch(QUrl const & url);
+
+    //! A tab started a request for `url`, running prefetches are
+    //! cancelled and queued again.
+    static void beginForeground(QUrl const & url);
+
+    //! A tab finished a request, prefetching continues when no other tab is loading.
+    static void endForeground();
+};
+
+#endif // PREFETCHER_HPP
@@ -0,0 +1,232 @@
+#include "redirectcache.hpp"
+#include "requesttiming.hpp"
+
+#include <algorithm>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QStringList>
+#include <QSet>
+#include <QDebug>
+
+static quint32 const file_magic = 0x52444952; // "RDIR"
+static quint32 const file_version = 1;
+
+//! Longest chain of redirects that is followed without a request
+static int const max_hops = 5;
+
+RedirectCache::RedirectCache() :
+    failure_lifetime(600 * qint64(1000000))
+{
+}
+
+void RedirectCache::setFailureLifetime(int lifetime_secs)
+{
+    this->failure_lifetime = lifetime_secs * qint64(1000000);
+    if(this->failure_lifetime <= 0)
+        this->failures.clear();
+}
+
+void RedirectCache::addRedirect(const QUrl &from, const QUrl &to)
+{
+    auto const k = key(from);
+    if(k == key(to) or from.scheme() != to.scheme())
+        return;
+
+    auto const target = to.adjusted(QUrl::RemoveFragment);
+    auto it = this->redirects.find(k);
+    if(it != this->redirects.end() and it->target == target)
+        return;
+
+    this->redirects.insert(k, Redirect { target, QDateTime::currentDateTimeUtc() });
+    this->failures.remove(k);
+    this->save();
+}
+
+QUrl RedirectCache::resolve(const QUrl &url) const
+{
+    if(this->redirects.isEmpty())
+        return url;
+
+    QUrl result = url;
+    QSet<QString> visited;
+    for(int hop = 0; hop < max_hops; hop++)
+    {
+        auto const k = key(result);
+        auto it = this->redirects.find(k);
+        // Redirect files of older versions may contain other schemes
+        if(it == this->redirects.end() or it->target.scheme() != url.scheme())
+            break;
+        visited.insert(k);
+        if(visited.contains(key(it->target)))
+            return url;
+        result = it->target;
+    }
+
+    if(result.fragment().isEmpty() and url.hasFragment())
+        result.setFragment(url.fragment());
+    return result;
+}
+
+void RedirectCache::addFailure(const QUrl &url, int status, const QString &meta)
+{
+    if(this->failure_lifetime <= 0)
+        return;
+    this->failures.insert(key(url), Failure { status, meta, RequestTiming::now() });
+}
+
+bool RedirectCache::findFailure(const QUrl &url, Failure &failure) const
+{
+    auto it = this->failures.find(key(url));
+    if(it == this->failures.end())
+        return false;
+    if(RequestTiming::now() - it->stored_at >= this->failure_lifetime)
+        return false;
+    failure = it.value();
+    return true;
+}
+
+void RedirectCache::removeFailure(const QUrl &url)
+{
+    this->failures.remove(key(url));
+}
+
+void RedirectCache::forget(const QString &key)
+{
+    this->failures.remove(key);
+    if(this->redirects.remove(key) > 0)
+        this->save();
+}
+
+void RedirectCache::clearFailures()
+{
+    this->failures.clear();
+}
+
+void RedirectCache::clear()
+{
+    this->failures.clear();
+    this->redirects.clear();
+    this->save();
+}
+
+bool RedirectCache::load(const QString &file_name)
+{
+    this->file_name = file_name;
+    this->redirects.clear();
+
+    QFile file { file_name };
+    if(not file.open(QFile::ReadOnly))
+        return false;
+
+    QDataStream stream { &file };
+    stream.setVersion(QDataStream::Qt_5_12);
+
+    quint32 magic, version, count;
+    stream >> magic >> version >> count;
+    if(magic != file_magic or version != file_version) {
+        qWarning() << "Ignoring redirect file with unknown format:" << file_name;
+        return false;
+    }
+
+    this->redirects.reserve(int(count));
+    for(quint32 i = 0; i < count and stream.status() == QDataStream::Ok; i++)
+    {
+        QString from;
+        QUrl target;
+        qint64 first_seen;
+        stream >> from >> target >> first_seen;
+        this->redirects.insert(from, Redirect { target, QDateTime::fromSecsSinceEpoch(first_seen, Qt::UTC) });
+    }
+
+    return (stream.status() == QDataStream::Ok);
+}
+
+bool RedirectCache::save() const
+{
+    if(this->file_name.isEmpty())
+        return false;
+
+    QDir().mkpath(QFileInfo(this->file_name).absolutePath());
+
+    QSaveFile file { this->file_name };
+    if(not file.open(QFile::WriteOnly))
+        return false;
+
+    QDataStream stream { &file };
+    stream.setVersion(QDataStream::Qt_5_12);
+
+    stream << file_magic << file_version << quint32(this->redirects.size());
+    for(auto it = this->redirects.begin(); it != this->redirects.end(); ++it)
+    {
+        stream << it.key() << it->target << it->first_seen.toSecsSinceEpoch();
+    }
+
+    return file.commit();
+}
+
+QByteArray RedirectCache::toGemini() const
+{
+    QString document;
+
+    document += "# Redirects\n";
+    document += "\n";
+    document += "Kristall follows permanent redirects it has seen before without asking the host again, and remembers for a while which pages were not found. Forget an entry if it is outdated.\n";
+    document += "\n";
+    document += "=> about:redirects?clear Forget all entries\n";
+    document += "\n";
+
+    auto const forget_link = [](QString const & key) {
+        return QString("=> about:redirects?forget=%1 Forget\n").arg(QString::fromLatin1(QUrl::toPercentEncoding(key)));
+    };
+
+    document += "## Permanent redirects\n";
+    QStringList keys = this->redirects.keys();
+    std::sort(keys.begin(), keys.end());
+    for(auto const & key : keys)
+    {
+        auto const & redirect = this->redirects[key];
+        document += "\n";
+        document += "=> " + key + " " + key + "\n";
+        document += "=> " + redirect.target.toString(QUrl::FullyEncoded) + " moved to " + redirect.target.toString() + "\n";
+        document += forget_link(key);
+    }
+
+    auto const now = RequestTiming::now();
+    document += "\n";
+    document += "## Recent failures\n";
+    keys = this->failures.keys();
+    std::sort(keys.begin(), keys.end());
+    for(auto const & key : keys)
+    {
+        auto const & failure = this->failures[key];
+        if(now - failure.stored_at >= this->failure_lifetime)
+            continue;
+        document += "\n";
+        document += QString("=> %1 %1 (%2 %3)\n").arg(key).arg(failure.status).arg(failure.meta);
+        document += forget_link(key);
+    }
+
+    return document.toUtf8();
+}
+
+qint64 RedirectCache::estimateMemoryUsage() const
+{
+    qint64 size = 0;
+    for(auto it = this->redirects.begin(); it != this->redirects.end(); ++it)
+    {
+        size += sizeof(Redirect) + sizeof(QChar) * (it.key().size() + it->target.toString().size());
+    }
+    for(auto it = this->failures.begin(); it != this->failures.end(); ++it)
+    {
+        size += sizeof(Failure) + sizeof(QChar) * (it.key().size() + it->meta.size());
+    }
+    return size;
+}
+
+QString RedirectCache::key(const QUrl &url)
+{
+    return url.adjusted(QUrl::RemoveFragment | QUrl::NormalizePathSegments).toString(QUrl::FullyEncoded);
+}
@@ -0,0 +1,80 @@
+#ifndef REDIRECTCACHE_HPP
+#define REDIRECTCACHE_HPP
+
+#include <QUrl>
+#include <QHash>
+#include <QString>
+#include <QDateTime>
+#include <QByteArray>
+
+//! Remembers permanent redirects (status 31) and, for a short time,
+//! locations that were not found or are gone (status 51 and 52), so
+//! known hops and failures don't cost a request. Redirects are stored
+//! on disk, failures only in memory.
+class RedirectCache
+{
+public:
+    struct Failure
+    {
+        int status = 0;
+        QString meta;
+        qint64 stored_at = 0;
+    };
+
+    RedirectCache();
+
+    //! Failures are kept for `lifetime_secs` seconds, 0 disables the failure cache.
+    void setFailureLifetime(int lifetime_secs);
+
+    //! Stores that `from` moved permanently to `to`. Redirects to
+    //! another scheme are ignored, the user has to confirm those.
+    void addRedirect(QUrl const & from, QUrl const & to);
+
+    //! Follows all known permanent redirects of `url` that keep its scheme. The fragment of
+    //! `url` is kept unless the target has its own. Returns `url` if
+    //! there is no redirect or the redirects form a loop.
+    QUrl resolve(QUrl const & url) const;
+
+    //! Stores that requesting `url` failed with `status` and `meta`.
+    void addFailure(QUrl const & url, int status, QString const & meta);
+
+    //! Looks up a failure of `url` that is not older than the lifetime.
+    bool findFailure(QUrl const & url, Failure & failure) const;
+
+    //! Removes the failure stored for `url`, so it is requested again.
+    void removeFailure(QUrl const & url);
+
+    //! Removes the redirect and the failure stored for `key`.
+    void forget(QString const & key);
+
+    //! Removes all failures, redirects stay.
+    void clearFailures();
+
+    void clear();
+
+    //! Loads the redirects from `file_name` and saves all changes back to it.
+    bool load(QString const & file_name);
+
+    bool save() const;
+
+    //! Renders all redirects and failures as a text/gemini page.
+    QByteArray toGemini() const;
+
+    qint64 estimateMemoryUsage() const;
+
+    static QString key(QUrl const & url);
+
+private:
+    struct Redirect
+    {
+        QUrl target;
+        QDateTime first_seen;
+    };
+
+    QString file_name;
+    QHash<QString, Redirect> redirects;
+    QHash<QString, Failure> failures;
+    qint64 failure_lifetime;
+};
+
+#endif // REDIRECTCACHE_HPP
@@ -0,0 +1,153 @@
+#include "renderstyle.hpp"
+
+#include "tracer.hpp"
+
+#include <QHash>
+#include <QVector>
+#include <QPair>
+#include <QTextBlock>
+#include <QTextCursor>
+
+//! The cache is dropped when more hosts than this were visited
+static int const max_cached_hosts = 256;
+
+static QHash<QString, std::shared_ptr<RenderStyle const>> styles;
+static int current_revision = 0;
+
+static QTextCharFormat charFormat(RenderStyle::Role role, QFont const & font, QColor const & color)
+{
+    QTextCharFormat format;
+    format.setFont(font);
+    format.setForeground(QBrush(color));
+    format.setProperty(RenderStyle::role_property, int(role));
+    return format;
+}
+
+RenderStyle::RenderStyle(const DocumentStyle &style) :
+    style(style),
+    style_sheet(style.toStyleSheet()),
+    standard(charFormat(StandardRole, style.standard_font, style.standard_color)),
+    preformatted(charFormat(PreformattedRole, style.preformatted_font, style.preformatted_color)),
+    preformatted_link(charFormat(PreformattedLinkRole, style.preformatted_font, style.internal_link_color)),
+    internal_link(charFormat(InternalLinkRole, style.standard_font, style.internal_link_color)),
+    external_link(charFormat(ExternalLinkRole, style.standard_font, style.external_link_color)),
+    cross_scheme_link(charFormat(CrossSchemeLinkRole, style.standard_font, style.cross_scheme_link_color)),
+    h1(charFormat(H1Role, style.h1_font, style.h1_color)),
+    h2(charFormat(H2Role, style.h2_font, style.h2_color)),
+    h3(charFormat(H3Role, style.h3_font, style.h3_color))
+{
+    preformatted_block.setNonBreakableLines(true);
+    preformatted_block.setProperty(role_property, int(PreformattedBlockRole));
+
+    block_quote_block.setIndent(1);
+    block_quote_block.setBackground(style.blockquote_color);
+    block_quote_block.setProperty(role_property, int(BlockQuoteBlockRole));
+}
+
+void RenderStyle::restyle(QTextDocument &document) const
+{
+    TraceScope trace { "render", "RenderStyle::restyle" };
+
+    struct Change
+    {
+        int position;
+        int length;
+        QTextCharFormat format;
+    };
+
+    // Changing formats splits and merges fragments, so the changes are
+    // collected first and applied afterwards
+    QVector<QPair<int, QTextBlockFormat>> block_changes;
+    QVector<Change> char_changes;
+    for(QTextBlock block = document.begin(); block.isValid(); block = block.next())
+    {
+        auto const block_role = block.blockFormat().intProperty(role_property);
+        if(block_role == BlockQuoteBlockRole or block_role == PreformattedBlockRole)
+        {
+            QTextBlockFormat format = block.blockFormat();
+            format.merge((block_role == BlockQuoteBlockRole) ? block_quote_block : preformatted_block);
+            block_changes.append(qMakePair(block.position(), format));
+        }
+
+        for(auto it = block.begin(); not it.atEnd(); ++it)
+        {
+            auto const fragment = it.fragment();
+            auto const current = fragment.charFormat();
+            auto const * role_format = this->charFormat(current.intProperty(role_property));
+            if(role_format == nullptr)
+                continue;
+
+            QFont font = role_format->font();
+            if(current.boolProperty(bold_property))
+                font.setBold(true);
+
+            QTextCharFormat format = current;
+            format.setFont(font);
+            format.setForeground(role_format->foreground());
+            format.setUnderlineStyle(current.underlineStyle());
+            char_changes.append(Change { fragment.position(), fragment.length(), format });
+        }
+    }
+
+    document.setDocumentMargin(style.margin);
+
+    QTextCursor cursor { &document };
+    cursor.beginEditBlock();
+    for(auto const & change : block_changes)
+    {
+        cursor.setPosition(change.first);
+        cursor.setBlockFormat(change.second);
+    }
+    for(auto const & change : char_changes)
+    {
+        cursor.setPosition(change.position);
+        cursor.setPosition(change.position + change.length, QTextCursor::KeepAnchor);
+        cursor.setCharFormat(change.format);
+    }
+    cursor.endEditBlock();
+}
+
+QTextCharFormat const * RenderStyle::charFormat(int role) const
+{
+    switch(role)
+    {
+    case StandardRole: return &standard;
+    case PreformattedRole: return &preformatted;
+    case PreformattedLinkRole: return &preformatted_link;
+    case InternalLinkRole: return &internal_link;
+    case ExternalLinkRole: return &external_link;
+    case CrossSchemeLinkRole: return &cross_scheme_link;
+    case H1Role: return &h1;
+    case H2Role: return &h2;
+    case H3Role: return &h3;
+    default: return nullptr;
+    }
+}
+
+std::shared_ptr<RenderStyle const> StyleCache::get(const DocumentStyle &base, const QUrl &url)
+{
+    // Fixed themes look the same on all hosts
+    auto const key = (base.theme == DocumentStyle::Fixed) ? QString { } : url.host();
+
+    auto it = styles.find(key);
+    if(it != styles.end())
+        return it.value();
+
+    if(styles.size() >= max_cached_hosts)
+        styles.clear();
+
+    auto style = std::make_shared<RenderStyle const>(base.derive(url));
+    styles.insert(key, style);
+    return style;
+}
+
+void StyleCache::invalidate()
+{
+    styles.clear();
+    current_revision += 1;
+}
+
+int StyleCache::revision()
+{
+    return current_revision;
+}
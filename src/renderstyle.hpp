@@ -0,0 +1,86 @@
+#ifndef RENDERSTYLE_HPP
+#define RENDERSTYLE_HPP
+
+#include "documentstyle.hpp"
+
+#include <memory>
+#include <QUrl>
+#include <QString>
+#include <QTextCharFormat>
+#include <QTextBlockFormat>
+#include <QTextDocument>
+
+//! A document style together with the text formats and the style
+//! sheet the renderers build from it.
+struct RenderStyle
+{
+    //! Which format of the style a text fragment or block was rendered with.
+    //! Stored in the formats, so a document can be restyled later.
+    enum Role {
+        NoRole = 0,
+        StandardRole,
+        PreformattedRole,
+        PreformattedLinkRole,
+        InternalLinkRole,
+        ExternalLinkRole,
+        CrossSchemeLinkRole,
+        H1Role,
+        H2Role,
+        H3Role,
+        PreformattedBlockRole,
+        BlockQuoteBlockRole,
+    };
+
+    //! Format property that holds the Role
+    static int const role_property = QTextFormat::UserProperty + 1;
+
+    //! Char format property of text that is bold independent of the style's font
+    static int const bold_property = QTextFormat::UserProperty + 2;
+
+    explicit RenderStyle(DocumentStyle const & style);
+
+    //! Applies this style to a document that was rendered with another
+    //! style, without rendering it again. Only formats with a role change.
+    void restyle(QTextDocument & document) const;
+
+    DocumentStyle style;
+
+    //! CSS for HTML and Markdown documents
+    QString style_sheet;
+
+    QTextCharFormat standard;
+    QTextCharFormat preformatted;
+    QTextCharFormat preformatted_link;
+    QTextCharFormat internal_link;
+    QTextCharFormat external_link;
+    QTextCharFormat cross_scheme_link;
+    QTextCharFormat h1;
+    QTextCharFormat h2;
+    QTextCharFormat h3;
+
+    QTextBlockFormat preformatted_block;
+    QTextBlockFormat block_quote_block;
+
+private:
+    QTextCharFormat const * charFormat(int role) const;
+};
+
+//! Keeps the render style of each host, so deriving the colors and
+//! building the formats happens once per host and not on every page load.
+//! Must only be used from the GUI thread.
+struct StyleCache
+{
+    StyleCache() = delete;
+
+    //! Returns the style for `url` derived from `base`. `base` is
+    //! expected to stay the same until `invalidate()` is called.
+    static std::shared_ptr<RenderStyle const> get(DocumentStyle const & base, QUrl const & url);
+
+    //! Drops all cached styles, must be called when the theme changes.
+    static void invalidate();
+
+    //! Incremented by each `invalidate()`
+    static int revision();
+};
+
+#endif // RENDERSTYLE_HPP
@@ -0,0 +1,101 @@
+#include "requestcoalescer.hpp"
+#include "browsertab.hpp"
+
+#include <QHash>
+#include <QList>
+#include <QPointer>
+#include <QCryptographicHash>
+
+struct Flight
+{
+    BrowserTab * leader;
+    QList<QPointer<BrowserTab>> waiters;
+};
+
+static QHash<QString, Flight> flights;
+
+static QHash<QString, Flight>::iterator findLeader(BrowserTab * leader)
+{
+    for(auto it = flights.begin(); it != flights.end(); ++it)
+    {
+        if(it->leader == leader)
+            return it;
+    }
+    return flights.end();
+}
+
+QString RequestCoalescer::key(const QUrl &url, const CryptoIdentity &identity)
+{
+    QString key = url.adjusted(QUrl::RemoveFragment | QUrl::NormalizePathSegments).toString(QUrl::FullyEncoded);
+    if(identity.isValid()) {
+        key += " " + QString::fromLatin1(identity.certificate.digest(QCryptographicHash::Sha256).toHex());
+    }
+    return key;
+}
+
+bool RequestCoalescer::join(const QString &key, BrowserTab *tab)
+{
+    auto it = flights.find(key);
+    if(it == flights.end()) {
+        flights.insert(key, Flight { tab, { } });
+        return false;
+    }
+    it->waiters.append(tab);
+    return true;
+}
+
+void RequestCoalescer::complete(BrowserTab *leader, const QByteArray &data, const QString &mime)
+{
+    auto it = findLeader(leader);
+    if(it == flights.end())
+        return;
+
+    auto const key = it.key();
+    auto const waiters = it->waiters;
+    flights.erase(it);
+
+    // Each tab renders in its own event, so the leader is not delayed.
+    // `data` is shared, not copied.
+    for(auto const & tab : waiters)
+    {
+        if(tab.isNull())
+            continue;
+        QPointer<BrowserTab> target = tab;
+        QMetaObject::invokeMethod(tab.data(), [target, key, data, mime]() {
+            if(not target.isNull())
+                target->on_coalescedResponse(key, data, mime);
+        }, Qt::QueuedConnection);
+    }
+}
+
+void RequestCoalescer::abandon(BrowserTab *leader)
+{
+    auto it = findLeader(leader);
+    if(it == flights.end())
+        return;
+
+    auto const key = it.key();
+    auto const waiters = it->waiters;
+    flights.erase(it);
+
+    for(auto const & tab : waiters)
+    {
+        if(tab.isNull())
+            continue;
+        QPointer<BrowserTab> target = tab;
+        QMetaObject::invokeMethod(tab.data(), [target, key]() {
+            if(not target.isNull())
+                target->on_coalescedRequestAbandoned(key);
+        }, Qt::QueuedConnection);
+    }
+}
+
+void RequestCoalescer::leave(BrowserTab *tab)
+{
+    abandon(tab);
+
+    for(auto & flight : flights)
+    {
+        flight.waiters.removeAll(tab);
+    }
+}
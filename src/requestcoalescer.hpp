@@ -0,0 +1,37 @@
+#ifndef REQUESTCOALESCER_HPP
+#define REQUESTCOALESCER_HPP
+
+#include <QUrl>
+#include <QString>
+#include <QByteArray>
+
+#include "cryptoidentity.hpp"
+
+class BrowserTab;
+
+//! Deduplicates requests of several tabs for the same URL. The first
+//! tab fetches the URL, all other tabs wait and get the same response.
+struct RequestCoalescer
+{
+    RequestCoalescer() = delete;
+
+    //! Key of a request for `url` that is sent with `identity`.
+    //! Requests with different client certificates never share a response.
+    static QString key(QUrl const & url, CryptoIdentity const & identity);
+
+    //! Returns true if another tab already fetches `key` and `tab` now waits
+    //! for it. Otherwise `tab` becomes the tab that fetches `key`.
+    static bool join(QString const & key, BrowserTab * tab);
+
+    //! `leader` received `data`, which is passed on to all waiting tabs.
+    static void complete(BrowserTab * leader, QByteArray const & data, QString const & mime);
+
+    //! `leader` ended without a response body, the waiting tabs send
+    //! their own requests.
+    static void abandon(BrowserTab * leader);
+
+    //! Removes `tab` from all requests, e.g. when it navigates elsewhere.
+    static void leave(BrowserTab * tab);
+};
+
+#endif // REQUESTCOALESCER_HPP
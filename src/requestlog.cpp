@@ -0,0 +1,315 @@
+#include "requestlog.hpp"
+
+#include <algorithm>
+#include <QStringList>
+
+static const int waterfall_width = 48;
+
+RequestLog::RequestLog(int capacity) :
+    ring(),
+    next_slot(0),
+    max_entries(std::max(1, capacity))
+{
+
+}
+
+void RequestLog::add(const RequestRecord &record)
+{
+    if(this->ring.size() < this->max_entries) {
+        this->ring.append(record);
+    } else {
+        this->ring[this->next_slot] = record;
+    }
+    this->next_slot = (this->next_slot + 1) % this->max_entries;
+}
+
+void RequestLog::clear()
+{
+    this->ring.clear();
+    this->next_slot = 0;
+}
+
+void RequestLog::setCapacity(int capacity)
+{
+    capacity = std::max(1, capacity);
+    if(capacity == this->max_entries)
+        return;
+
+    auto items = this->entries(ByTime);
+    if(items.size() > capacity) {
+        items.remove(0, items.size() - capacity);
+    }
+
+    this->ring = items;
+    this->max_entries = capacity;
+    this->next_slot = this->ring.size() % this->max_entries;
+}
+
+QVector<RequestRecord> RequestLog::entries(SortKey key) const
+{
+    QVector<RequestRecord> result;
+    result.reserve(this->ring.size());
+
+    int const oldest = (this->ring.size() < this->max_entries) ? 0 : this->next_slot;
+    for(int i = 0; i < this->ring.size(); i++) {
+        result.append(this->ring.at((oldest + i) % this->ring.size()));
+    }
+
+    switch(key)
+    {
+    case ByTime:
+        break;
+    case ByDuration:
+        std::stable_sort(result.begin(), result.end(), [](RequestRecord const & a, RequestRecord const & b) {
+            return a.timing.total() > b.timing.total();
+        });
+        break;
+    case BySize:
+        std::stable_sort(result.begin(), result.end(), [](RequestRecord const & a, RequestRecord const & b) {
+            return a.bytes > b.bytes;
+        });
+        break;
+    case ByStatus:
+        std::stable_sort(result.begin(), result.end(), [](RequestRecord const & a, RequestRecord const & b) {
+            return a.status < b.status;
+        });
+        break;
+    case ByUrl:
+        std::stable_sort(result.begin(), result.end(), [](RequestRecord const & a, RequestRecord const & b) {
+            return a.url.toString() < b.url.toString();
+        });
+        break;
+    }
+
+    return result;
+}
+
+static char phaseSymbol(RequestTiming::Phase phase)
+{
+    switch(phase)
+    {
+    case RequestTiming::HostLookup:  return 'd';
+    case RequestTiming::Connected:   return 'c';
+    case RequestTiming::Handshake:   return 't';
+    case RequestTiming::RequestSent: return 'w';
+    case RequestTiming::FirstByte:   return 'w';
+    case RequestTiming::Transferred: return '=';
+    case RequestTiming::Rendered:    return 'r';
+    case RequestTiming::Displayed:   return 'r';
+    case RequestTiming::LayoutDone:  return 'l';
+    default:                         return '.';
+    }
+}
+
+static qint64 firstStamp(RequestTiming const & timing)
+{
+    for(auto stamp : timing.stamps) {
+        if(stamp >= 0)
+            return stamp;
+    }
+    return -1;
+}
+
+static QString waterfall(RequestTiming const & timing, qint64 origin, qint64 span)
+{
+    QString bar(waterfall_width, ' ');
+
+    auto column = [&](qint64 stamp) -> int {
+        return int(std::min<qint64>(waterfall_width - 1, (stamp - origin) * waterfall_width / span));
+    };
+
+    qint64 previous = firstStamp(timing);
+    if(previous < 0)
+        return bar;
+
+    for(int i = 1; i < RequestTiming::PhaseCount; i++)
+    {
+        auto const phase = RequestTiming::Phase(i);
+        if(not timing.has(phase))
+            continue;
+
+        int const from = column(previous);
+        int const to = std::max(from + 1, column(timing.stamp(phase)));
+        for(int c = from; c < to and c < waterfall_width; c++) {
+            bar[c] = phaseSymbol(phase);
+        }
+        previous = timing.stamp(phase);
+    }
+
+    return bar;
+}
+
+QByteArray RequestLog::toGemini(SortKey key) const
+{
+    auto const items = this->entries(key);
+
+    qint64 origin = -1;
+    qint64 end = -1;
+    for(auto const & item : items)
+    {
+        qint64 const start = firstStamp(item.timing);
+        if(start < 0)
+            continue;
+        if(origin < 0 or start < origin)
+            origin = start;
+        end = std::max(end, start + item.timing.total());
+    }
+    qint64 const span = std::max<qint64>(1, end - origin);
+
+    QString document;
+
+    document += "# Network\n";
+    document += "\n";
+    document += QString("%1 of the last %2 requests across all tabs.\n").arg(items.size()).arg(this->max_entries);
+    document += "\n";
+    document += "=> about:network?sort=time Sort by start time\n";
+    document += "=> about:network?sort=duration Sort by duration\n";
+    document += "=> about:network?sort=size Sort by size\n";
+    document += "=> about:network?sort=status Sort by status\n";
+    document += "=> about:network?sort=url Sort by URL\n";
+    document += "=> about:network?format=csv Export as CSV\n";
+    document += "=> about:network?clear Clear the log\n";
+    document += "\n";
+    document += "## Requests\n";
+    document += "\n";
+    document += "```\n";
+    document += QString("%1 %2 %3 %4 %5 %6 %7 %8 %9\n")
+        .arg("Time", -8)
+        .arg("Tab", 3)
+        .arg("St", -3)
+        .arg("Proto", -6)
+        .arg("Size", 10)
+        .arg("Total", 10)
+        .arg("C", 1)
+        .arg(QString("Waterfall"), -waterfall_width)
+        .arg("URL");
+
+    for(auto const & item : items)
+    {
+        document += QString("%1 %2 %3 %4 %5 %6 %7 %8 %9\n")
+            .arg(item.started.toString("hh:mm:ss"), -8)
+            .arg(item.tab_id, 3)
+            .arg(item.error.isEmpty() ? item.status : "ERR", -3)
+            .arg(item.protocol, -6)
+            .arg(item.bytes, 10)
+            .arg(QString("%1 ms").arg(item.timing.total() / 1000.0, 0, 'f', 1), 10)
+            .arg(item.cache_hit ? "C" : " ", 1)
+            .arg(waterfall(item.timing, origin, span), -waterfall_width)
+            .arg(item.url.toString());
+    }
+
+    document += "```\n";
+    document += "\n";
+    document += "Legend: d DNS, c connect, t TLS, w waiting, = transfer, r render, l layout, C cache hit\n";
+
+    bool has_redirects = false;
+    for(auto const & item : items)
+    {
+        if(item.redirects.isEmpty())
+            continue;
+        if(not has_redirects) {
+            document += "\n## Redirect chains\n\n";
+            has_redirects = true;
+        }
+        QStringList chain;
+        chain << item.url.toString();
+        for(auto const & hop : item.redirects) {
+            chain << hop.toString();
+        }
+        document += "* " + chain.join(" → ") + "\n";
+    }
+
+    bool has_errors = false;
+    for(auto const & item : items)
+    {
+        if(item.error.isEmpty())
+            continue;
+        if(not has_errors) {
+            document += "\n## Errors\n\n";
+            has_errors = true;
+        }
+        document += "* " + item.url.toString() + ": " + item.error.simplified() + "\n";
+    }
+
+    return document.toUtf8();
+}
+
+static QString csvField(QString field)
+{
+    if(field.contains(',') or field.contains('"') or field.contains('\n')) {
+        field.replace("\"", "\"\"");
+        return "\"" + field + "\"";
+    }
+    return field;
+}
+
+QByteArray RequestLog::toCsv(SortKey key) const
+{
+    QStringList header;
+    header << "started" << "tab" << "protocol" << "status" << "mime" << "bytes" << "cache_hit" << "url" << "redirects" << "error";
+    for(int i = 1; i < RequestTiming::PhaseCount; i++) {
+        header << QString("%1 (ms)").arg(RequestTiming::phaseName(RequestTiming::Phase(i)));
+    }
+    header << "Total (ms)";
+
+    QString document;
+    for(auto & field : header) {
+        field = csvField(field);
+    }
+    document += header.join(",") + "\n";
+
+    for(auto const & item : this->entries(key))
+    {
+        QStringList redirects;
+        for(auto const & hop : item.redirects) {
+            redirects << hop.toString();
+        }
+
+        QStringList row;
+        row << item.started.toString(Qt::ISODateWithMs)
+            << QString::number(item.tab_id)
+            << item.protocol
+            << item.status
+            << item.mime
+            << QString::number(item.bytes)
+            << (item.cache_hit ? "yes" : "no")
+            << item.url.toString()
+            << redirects.join(" ")
+            << item.error.simplified();
+
+        for(int i = 1; i < RequestTiming::PhaseCount; i++) {
+            auto const duration = item.timing.duration(RequestTiming::Phase(i));
+            row << ((duration >= 0) ? QString::number(duration / 1000.0, 'f', 1) : QString());
+        }
+        row << QString::number(item.timing.total() / 1000.0, 'f', 1);
+
+        for(auto & field : row) {
+            field = csvField(field);
+        }
+        document += row.join(",") + "\n";
+    }
+
+    return document.toUtf8();
+}
+
+qint64 RequestLog::estimateMemoryUsage() const
+{
+    qint64 size = sizeof(RequestRecord) * this->ring.capacity();
+    for(auto const & item : this->ring)
+    {
+        size += sizeof(QChar) * (item.url.toString().size() + item.mime.size() + item.error.size());
+        for(auto const & hop : item.redirects) {
+            size += sizeof(QChar) * hop.toString().size();
+        }
+    }
+    return size;
+}
+
+RequestLog::SortKey RequestLog::parseSortKey(const QString &name)
+{
+    if(name == "duration") return ByDuration;
+    if(name == "size") return BySize;
+    if(name == "status") return ByStatus;
+    if(name == "url") return ByUrl;
+    return ByTime;
+}
@@ -0,0 +1,72 @@
+#ifndef REQUESTLOG_HPP
+#define REQUESTLOG_HPP
+
+#include <QUrl>
+#include <QList>
+#include <QVector>
+#include <QDateTime>
+#include <QByteArray>
+
+#include "requesttiming.hpp"
+
+//! A single finished request as shown on about:network
+struct RequestRecord
+{
+    int tab_id = 0;
+    QUrl url;
+    QString protocol;
+    QString status;
+    QString mime;
+    QString error;
+    qint64 bytes = 0;
+    QList<QUrl> redirects;
+    bool cache_hit = false;
+    QDateTime started;
+    RequestTiming timing;
+};
+
+//! Bounded ring buffer of the last finished requests across all tabs.
+class RequestLog
+{
+public:
+    enum SortKey {
+        ByTime,
+        ByDuration,
+        BySize,
+        ByStatus,
+        ByUrl,
+    };
+
+    explicit RequestLog(int capacity = 200);
+
+    void add(RequestRecord const & record);
+
+    void clear();
+
+    void setCapacity(int capacity);
+
+    int capacity() const {
+        return this->max_entries;
+    }
+
+    //! Returns all entries, sorted by `key`.
+    QVector<RequestRecord> entries(SortKey key = ByTime) const;
+
+    //! Renders the log as a text/gemini page with a text waterfall.
+    QByteArray toGemini(SortKey key) const;
+
+    //! Renders the log as text/csv for exporting.
+    QByteArray toCsv(SortKey key) const;
+
+    static SortKey parseSortKey(QString const & name);
+
+    //! Rough estimate of the memory used by the log in bytes.
+    qint64 estimateMemoryUsage() const;
+
+private:
+    QVector<RequestRecord> ring;
+    int next_slot;
+    int max_entries;
+};
+
+#endif // REQUESTLOG_HPP
@@ -0,0 +1,135 @@
+#include "requesttiming.hpp"
+
+#include <chrono>
+#include <QStringList>
+
+RequestTiming::RequestTiming()
+{
+    this->stamps.fill(-1);
+}
+
+qint64 RequestTiming::now()
+{
+    auto const time = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::microseconds>(time).count();
+}
+
+void RequestTiming::start(Phase first)
+{
+    this->stamps.fill(-1);
+    this->mark(first);
+}
+
+void RequestTiming::mark(Phase phase)
+{
+    this->stamps[phase] = now();
+}
+
+void RequestTiming::markOnce(Phase phase)
+{
+    if(not this->has(phase))
+        this->mark(phase);
+}
+
+void RequestTiming::mergeNetwork(const RequestTiming &other)
+{
+    for(int i = RequestStart; i <= Transferred; i++)
+    {
+        if(other.stamps[i] >= 0)
+            this->stamps[i] = other.stamps[i];
+    }
+}
+
+qint64 RequestTiming::duration(Phase phase) const
+{
+    if(not this->has(phase))
+        return -1;
+    for(int i = phase - 1; i >= 0; i--)
+    {
+        if(this->stamps[i] >= 0)
+            return this->stamps[phase] - this->stamps[i];
+    }
+    return 0;
+}
+
+qint64 RequestTiming::total() const
+{
+    qint64 first = -1;
+    qint64 last = -1;
+    for(auto stamp : this->stamps)
+    {
+        if(stamp < 0)
+            continue;
+        if(first < 0)
+            first = stamp;
+        last = stamp;
+    }
+    return (first >= 0) ? (last - first) : 0;
+}
+
+qint64 RequestTiming::elapsed(Phase since) const
+{
+    if(not this->has(since))
+        return 0;
+    return now() - this->stamps[since];
+}
+
+QString RequestTiming::toString() const
+{
+    QStringList lines;
+    for(int i = 1; i < PhaseCount; i++)
+    {
+        auto const phase = Phase(i);
+        if(not this->has(phase))
+            continue;
+        lines << QString("%1: %2 ms")
+            .arg(phaseName(phase))
+            .arg(this->duration(phase) / 1000.0, 0, 'f', 1);
+    }
+    lines << QString("Total: %1 ms").arg(this->total() / 1000.0, 0, 'f', 1);
+    return lines.join("\n");
+}
+
+char const * RequestTiming::phaseName(Phase phase)
+{
+    switch(phase)
+    {
+    case Navigate:     return "Navigation";
+    case RequestStart: return "Setup";
+    case HostLookup:   return "DNS lookup";
+    case Connected:    return "TCP connect";
+    case Handshake:    return "TLS handshake";
+    case RequestSent:  return "Request";
+    case FirstByte:    return "Time to first byte";
+    case Transferred:  return "Transfer";
+    case Rendered:     return "Parse and build document";
+    case Displayed:    return "Set document";
+    case LayoutDone:   return "Layout";
+    case PhaseCount:   break;
+    }
+    return "Unknown";
+}
+
+void SharedRequestTiming::start(RequestTiming::Phase first)
+{
+    QMutexLocker lock { &this->mutex };
+    this->timing.start(first);
+}
+
+void SharedRequestTiming::mark(RequestTiming::Phase phase)
+{
+    QMutexLocker lock { &this->mutex };
+    this->timing.mark(phase);
+}
+
+void SharedRequestTiming::markOnce(RequestTiming::Phase phase)
+{
+    QMutexLocker lock { &this->mutex };
+    this->timing.markOnce(phase);
+}
+
+RequestTiming SharedRequestTiming::get() const
+{
+    QMutexLocker lock { &this->mutex };
+    return this->timing;
+}
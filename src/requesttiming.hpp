@@ -0,0 +1,93 @@
+#ifndef REQUESTTIMING_HPP
+#define REQUESTTIMING_HPP
+
+#include <QString>
+#include <QMutex>
+#include <array>
+
+//! Timestamps for the phases of a single request and its display.
+//! All stamps are taken from a monotonic clock in microseconds, so
+//! records filled by different objects can be merged without
+//! converting between timers.
+struct RequestTiming
+{
+    enum Phase {
+        Navigate,     //!< The tab started navigating to the url
+        RequestStart, //!< The protocol client started the (last) request
+        HostLookup,   //!< The host name was resolved
+        Connected,    //!< The TCP connection was established
+        Handshake,    //!< The TLS handshake was completed
+        RequestSent,  //!< The request was written to the socket
+        FirstByte,    //!< The first byte of the response was received
+        Transferred,  //!< The response was received completely
+        Rendered,     //!< The response was parsed into a document
+        Displayed,    //!< The document was set into the view
+        LayoutDone,   //!< The document layout was completed
+
+        PhaseCount
+    };
+
+    RequestTiming();
+
+    //! Returns the current monotonic time in microseconds.
+    static qint64 now();
+
+    //! Clears all phases and marks `first` as the current time.
+    void start(Phase first = RequestStart);
+
+    //! Stores the current time for `phase`.
+    void mark(Phase phase);
+
+    //! Stores the current time for `phase` if it was not reached before.
+    void markOnce(Phase phase);
+
+    bool has(Phase phase) const {
+        return this->stamps[phase] >= 0;
+    }
+
+    qint64 stamp(Phase phase) const {
+        return this->stamps[phase];
+    }
+
+    //! Copies all network phases (RequestStart up to Transferred)
+    //! that were reached in `other`.
+    void mergeNetwork(RequestTiming const & other);
+
+    //! Duration of `phase` in microseconds, measured from the last
+    //! reached phase before it. Returns -1 if `phase` was not reached.
+    qint64 duration(Phase phase) const;
+
+    //! Time from the first to the last reached phase in microseconds.
+    qint64 total() const;
+
+    //! Microseconds passed since `since` was reached.
+    qint64 elapsed(Phase since) const;
+
+    //! Returns a multi-line, human readable breakdown of all reached phases.
+    QString toString() const;
+
+    static char const * phaseName(Phase phase);
+
+    std::array<qint64, PhaseCount> stamps;
+};
+
+//! RequestTiming of a protocol client. It is written on the network
+//! thread and read by the tabs on the GUI thread.
+class SharedRequestTiming
+{
+public:
+    void start(RequestTiming::Phase first = RequestTiming::RequestStart);
+
+    void mark(RequestTiming::Phase phase);
+
+    void markOnce(RequestTiming::Phase phase);
+
+    //! Returns a copy of all stamps reached so far.
+    RequestTiming get() const;
+
+private:
+    mutable QMutex mutex;
+    RequestTiming timing;
+};
+
+#endif // REQUESTTIMING_HPP
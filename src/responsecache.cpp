@@ -0,0 +1,101 @@
+#include "responsecache.hpp"
+#include "requesttiming.hpp"
+
+ResponseCache::ResponseCache() :
+    total_bytes(0),
+    max_bytes(4 * 1024 * 1024),
+    max_age(300 * qint64(1000000))
+{
+}
+
+void ResponseCache::setLimits(qint64 max_bytes, int max_age_secs)
+{
+    this->max_bytes = max_bytes;
+    this->max_age = max_age_secs * qint64(1000000);
+    this->evict();
+}
+
+void ResponseCache::insert(const QUrl &url, const QByteArray &body, const QString &mime)
+{
+    if(body.size() > this->max_bytes)
+        return;
+
+    auto const k = key(url);
+    auto it = this->entries.find(k);
+    if(it != this->entries.end())
+        this->total_bytes -= it->body.size();
+
+    this->entries.insert(k, Entry { body, mime, RequestTiming::now() });
+    this->total_bytes += body.size();
+
+    this->evict();
+}
+
+bool ResponseCache::contains(const QUrl &url) const
+{
+    auto it = this->entries.find(key(url));
+    return (it != this->entries.end()) and (RequestTiming::now() - it->stored_at < this->max_age);
+}
+
+bool ResponseCache::take(const QUrl &url, Entry &entry)
+{
+    auto it = this->entries.find(key(url));
+    if(it == this->entries.end())
+        return false;
+
+    bool const fresh = (RequestTiming::now() - it->stored_at < this->max_age);
+    if(fresh)
+        entry = it.value();
+
+    this->total_bytes -= it->body.size();
+    this->entries.erase(it);
+
+    return fresh;
+}
+
+void ResponseCache::clear()
+{
+    this->entries.clear();
+    this->total_bytes = 0;
+}
+
+qint64 ResponseCache::estimateMemoryUsage() const
+{
+    qint64 size = this->total_bytes;
+    for(auto it = this->entries.begin(); it != this->entries.end(); ++it)
+    {
+        size += sizeof(Entry) + sizeof(QChar) * (it.key().size() + it->mime.size());
+    }
+    return size;
+}
+
+QString ResponseCache::key(const QUrl &url)
+{
+    return url.adjusted(QUrl::RemoveFragment).toString(QUrl::FullyEncoded);
+}
+
+void ResponseCache::evict()
+{
+    auto const now = RequestTiming::now();
+    for(auto it = this->entries.begin(); it != this->entries.end(); )
+    {
+        if(now - it->stored_at >= this->max_age) {
+            this->total_bytes -= it->body.size();
+            it = this->entries.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    while(this->total_bytes > this->max_bytes and not this->entries.isEmpty())
+    {
+        auto oldest = this->entries.begin();
+        for(auto it = this->entries.begin(); it != this->entries.end(); ++it)
+        {
+            if(it->stored_at < oldest->stored_at)
+                oldest = it;
+        }
+        this->total_bytes -= oldest->body.size();
+        this->entries.erase(oldest);
+    }
+}
@@ -0,0 +1,52 @@
+#ifndef RESPONSECACHE_HPP
+#define RESPONSECACHE_HPP
+
+#include <QUrl>
+#include <QHash>
+#include <QString>
+#include <QByteArray>
+
+//! In-memory cache of successful responses that were fetched
+//! ahead of a navigation. Each entry is handed out only once,
+//! so reloading a page always fetches it again.
+class ResponseCache
+{
+public:
+    struct Entry
+    {
+        QByteArray body;
+        QString mime;
+        qint64 stored_at = 0;
+    };
+
+    ResponseCache();
+
+    void setLimits(qint64 max_bytes, int max_age_secs);
+
+    void insert(QUrl const & url, QByteArray const & body, QString const & mime);
+
+    bool contains(QUrl const & url) const;
+
+    //! Removes the entry for `url` and stores it in `entry`.
+    //! Returns false if there is no entry or it is too old.
+    bool take(QUrl const & url, Entry & entry);
+
+    void clear();
+
+    qint64 estimateMemoryUsage() const;
+
+private:
+    static QString key(QUrl const & url);
+
+    //! Drops expired entries, then the oldest ones until
+    //! the cache fits into `max_bytes`.
+    void evict();
+
+private:
+    QHash<QString, Entry> entries;
+    qint64 total_bytes;
+    qint64 max_bytes;
+    qint64 max_age;
+};
+
+#endif // RESPONSECACHE_HPP
@@ -9,6 +9,7 @@
 #include <QMessageBox>
 
 #include "kristall.hpp"
+#include "stalldetector.hpp"
 
 SettingsDialog::SettingsDialog(QWidget *parent) :
     QDialog(parent),
@@ -236,7 +237,7 @@ Plain text document here.
     auto doc = GeminiRenderer::render(
         document,
         url,
-        current_style.derive(url),
+        RenderStyle(current_style.derive(url)),
         outline
     );
 
@@ -441,6 +442,8 @@ void SettingsDialog::on_preset_load_clicked()
 
 void SettingsDialog::on_SettingsDialog_accepted()
 {
+    StallScope stall { "SettingsDialog::on_SettingsDialog_accepted" };
+
     global_settings.setValue("gophermap_display", this->ui->gophermap_text->isChecked() ? "text" : "rendered");
     global_settings.setValue("text_display", this->ui->fancypants_off->isChecked() ? "plain" : "fancy");
     global_settings.setValue("text_decoration", this->ui->texthl_on->isChecked());
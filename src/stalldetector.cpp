@@ -0,0 +1,246 @@
+#include "stalldetector.hpp"
+#include "requesttiming.hpp"
+#include "ioutil.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <QMap>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QTimer>
+#include <QThread>
+#include <QVector>
+#include <QCoreApplication>
+#include <QDebug>
+
+namespace
+{
+    struct Operation
+    {
+        char const * name;
+        QUrl url;
+        qint64 bytes;
+        qint64 begin;
+    };
+
+    struct Offender
+    {
+        int count = 0;
+        qint64 total = 0;
+        qint64 worst = 0;
+        QString worst_detail;
+    };
+
+    qint64 threshold_us = 0;
+    qint64 heartbeat_us = 0;
+    std::atomic<qint64> last_heartbeat { 0 };
+
+    //! Protects `operations` and `offenders`, which are read by the watchdog
+    //! and by about:stalls.
+    QMutex mutex;
+    QVector<Operation> operations;
+    QMap<QString, Offender> offenders;
+
+    //! Set when an operation recorded a stall since the last heartbeat,
+    //! so the heartbeat does not count the same stall again.
+    bool stall_attributed = false;
+
+    std::thread * watchdog = nullptr;
+    std::atomic<bool> watchdog_running { false };
+
+    QString describe(Operation const & op)
+    {
+        QString result = op.name;
+        if(op.url.isValid())
+            result += " " + op.url.toString();
+        if(op.bytes >= 0)
+            result += " (" + IoUtil::size_human(op.bytes) + ")";
+        return result;
+    }
+
+    void record(QString const & operation, QString const & detail, qint64 duration)
+    {
+        qWarning() << "UI stalled for" << (duration / 1000) << "ms in" << qPrintable(detail.isEmpty() ? operation : detail);
+
+        QMutexLocker lock { &mutex };
+        auto & entry = offenders[operation];
+        entry.count += 1;
+        entry.total += duration;
+        if(duration > entry.worst) {
+            entry.worst = duration;
+            entry.worst_detail = detail;
+        }
+    }
+
+    void heartbeat()
+    {
+        qint64 const now = RequestTiming::now();
+        qint64 const stall = now - last_heartbeat.exchange(now) - heartbeat_us;
+
+        if(stall > threshold_us and not stall_attributed) {
+            record("Event loop (not instrumented)", QString { }, stall);
+        }
+        stall_attributed = false;
+    }
+
+    void watch()
+    {
+        bool reported = false;
+        while(watchdog_running.load())
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(std::max<qint64>(1000, threshold_us / 2)));
+
+            qint64 const blocked = RequestTiming::now() - last_heartbeat.load() - heartbeat_us;
+            if(blocked <= threshold_us) {
+                reported = false;
+                continue;
+            }
+            if(reported)
+                continue;
+            reported = true;
+
+            QString running;
+            {
+                QMutexLocker lock { &mutex };
+                if(not operations.isEmpty())
+                    running = describe(operations.last());
+            }
+
+            if(running.isEmpty())
+                qWarning() << "Event loop blocked for more than" << (blocked / 1000) << "ms outside of instrumented operations";
+            else
+                qWarning() << "Event loop blocked for more than" << (blocked / 1000) << "ms in" << qPrintable(running);
+        }
+    }
+}
+
+std::atomic<bool> StallDetector::enabled { false };
+
+void StallDetector::start(int threshold_ms)
+{
+    if(isEnabled() or threshold_ms <= 0)
+        return;
+
+    threshold_us = 1000 * qint64(threshold_ms);
+    heartbeat_us = std::max<qint64>(10000, threshold_us / 4);
+    last_heartbeat.store(RequestTiming::now());
+
+    auto * timer = new QTimer(QCoreApplication::instance());
+    timer->setTimerType(Qt::PreciseTimer);
+    timer->setInterval(int(heartbeat_us / 1000));
+    QObject::connect(timer, &QTimer::timeout, heartbeat);
+    timer->start();
+
+    watchdog_running.store(true);
+    watchdog = new std::thread(watch);
+
+    enabled.store(true);
+
+    qAddPostRoutine(StallDetector::stop);
+}
+
+void StallDetector::stop()
+{
+    enabled.store(false);
+    if(watchdog != nullptr) {
+        watchdog_running.store(false);
+        watchdog->join();
+        delete watchdog;
+        watchdog = nullptr;
+    }
+}
+
+bool StallDetector::beginOperation(const char *name, const QUrl &url, qint64 bytes)
+{
+    auto * app = QCoreApplication::instance();
+    if(app == nullptr or QThread::currentThread() != app->thread())
+        return false;
+
+    QMutexLocker lock { &mutex };
+    operations.append(Operation { name, url, bytes, RequestTiming::now() });
+    return true;
+}
+
+void StallDetector::endOperation()
+{
+    Operation op;
+    {
+        QMutexLocker lock { &mutex };
+        if(operations.isEmpty())
+            return;
+        op = operations.takeLast();
+    }
+
+    qint64 const duration = RequestTiming::now() - op.begin;
+    if(duration > threshold_us) {
+        record(op.name, describe(op), duration);
+        stall_attributed = true;
+    }
+}
+
+QByteArray StallDetector::toGemini()
+{
+    QString document;
+
+    document += "# UI Stalls\n";
+    document += "\n";
+
+    if(not isEnabled()) {
+        document += "The stall detector is disabled. Start Kristall with --stall-threshold <ms> or set \"stall_threshold\" in the settings file to enable it.\n";
+        return document.toUtf8();
+    }
+
+    document += QString("Operations that blocked the user interface for more than %1 ms, worst first.\n").arg(threshold_us / 1000);
+    document += "\n";
+    document += "=> about:stalls Refresh\n";
+    document += "=> about:stalls?clear Clear\n";
+    document += "\n";
+
+    QVector<QPair<QString, Offender>> items;
+    {
+        QMutexLocker lock { &mutex };
+        for(auto it = offenders.begin(); it != offenders.end(); ++it) {
+            items.append(qMakePair(it.key(), it.value()));
+        }
+    }
+    std::sort(items.begin(), items.end(), [](QPair<QString, Offender> const & a, QPair<QString, Offender> const & b) {
+        return a.second.total > b.second.total;
+    });
+
+    document += "```\n";
+    document += QString("%1 %2 %3 %4\n")
+        .arg("Operation", -32)
+        .arg("Count", 6)
+        .arg("Total", 12)
+        .arg("Worst", 12);
+    for(auto const & item : items)
+    {
+        document += QString("%1 %2 %3 %4\n")
+            .arg(item.first, -32)
+            .arg(item.second.count, 6)
+            .arg(QString("%1 ms").arg(item.second.total / 1000), 12)
+            .arg(QString("%1 ms").arg(item.second.worst / 1000), 12);
+    }
+    document += "```\n";
+
+    bool has_details = false;
+    for(auto const & item : items)
+    {
+        if(item.second.worst_detail.isEmpty())
+            continue;
+        if(not has_details) {
+            document += "\n## Worst occurrences\n\n";
+            has_details = true;
+        }
+        document += QString("* %1 ms: %2\n").arg(item.second.worst / 1000).arg(item.second.worst_detail);
+    }
+
+    return document.toUtf8();
+}
+
+void StallDetector::clear()
+{
+    QMutexLocker lock { &mutex };
+    offenders.clear();
+}
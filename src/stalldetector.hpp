@@ -0,0 +1,66 @@
+#ifndef STALLDETECTOR_HPP
+#define STALLDETECTOR_HPP
+
+#include <QUrl>
+#include <QString>
+#include <QByteArray>
+#include <atomic>
+
+//! Detects stalls of the GUI event loop that are longer than a threshold
+//! and attributes them to the instrumented operation that was running.
+//! A heartbeat timer on the GUI thread notices every stall after it ended,
+//! a watchdog thread logs stalls while they are still going on.
+struct StallDetector
+{
+    StallDetector() = delete;
+
+    //! Starts the heartbeat and the watchdog. Must be called from the GUI thread.
+    static void start(int threshold_ms);
+
+    //! Stops the watchdog thread.
+    static void stop();
+
+    static bool isEnabled() {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+    //! Marks the begin of an instrumented operation. Returns false if the
+    //! operation is not tracked because the detector is disabled or the
+    //! caller is not on the GUI thread.
+    static bool beginOperation(char const * name, QUrl const & url, qint64 bytes);
+
+    //! Marks the end of the innermost instrumented operation.
+    static void endOperation();
+
+    //! Renders the worst offenders as a text/gemini page.
+    static QByteArray toGemini();
+
+    static void clear();
+
+private:
+    static std::atomic<bool> enabled;
+};
+
+//! Marks an instrumented operation for the lifetime of the object.
+class StallScope
+{
+public:
+    explicit StallScope(char const * name, QUrl const & url = QUrl { }, qint64 bytes = -1) :
+        active(StallDetector::isEnabled() and StallDetector::beginOperation(name, url, bytes))
+    {
+    }
+
+    StallScope(StallScope const &) = delete;
+    StallScope & operator=(StallScope const &) = delete;
+
+    ~StallScope()
+    {
+        if(this->active)
+            StallDetector::endOperation();
+    }
+
+private:
+    bool active;
+};
+
+#endif // STALLDETECTOR_HPP
@@ -30,6 +30,15 @@ QModelIndex TabBrowsingHistory::pushUrl(QModelIndex const & position, const QUrl
     return this->createIndex(this->history.size() - 1, 0);
 }
 
+void TabBrowsingHistory::replaceUrl(const QModelIndex &position, const QUrl &url)
+{
+    if(not position.isValid() or position.row() >= history.size())
+        return;
+
+    this->history[position.row()] = url;
+    emit this->dataChanged(position, position);
+}
+
 QUrl TabBrowsingHistory::get(const QModelIndex &index) const
 {
     if(not index.isValid())
@@ -59,6 +68,16 @@ QModelIndex TabBrowsingHistory::oneBackward(QModelIndex index) const
     return createIndex(index.row() - 1, index.column());
 }
 
+qint64 TabBrowsingHistory::estimateMemoryUsage() const
+{
+    qint64 size = sizeof(QUrl) * this->history.capacity();
+    for(auto const & url : this->history) {
+        // QUrl stores its components as separate strings
+        size += 64 + sizeof(QChar) * url.toString().size();
+    }
+    return size;
+}
+
 int TabBrowsingHistory::rowCount(const QModelIndex &parent) const
 {
     return history.size();
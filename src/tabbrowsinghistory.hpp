@@ -18,12 +18,18 @@ public:
 
     QModelIndex pushUrl(QModelIndex const & position, QUrl const & url);
 
+    //! Replaces the url at `position`, used when the page moved permanently.
+    void replaceUrl(QModelIndex const & position, QUrl const & url);
+
     QUrl get(QModelIndex const & index) const;
 
     QModelIndex oneForward(QModelIndex index) const;
 
     QModelIndex oneBackward(QModelIndex index) const;
 
+    //! Rough estimate of the memory used by the history in bytes.
+    qint64 estimateMemoryUsage() const;
+
 public:
     int rowCount(const QModelIndex &parent = QModelIndex()) const override;
 
@@ -0,0 +1,203 @@
+#include "tracer.hpp"
+
+#include <QFile>
+#include <QThread>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QJsonDocument>
+#include <QCoreApplication>
+#include <QDebug>
+
+#include <algorithm>
+
+namespace
+{
+    struct TraceEvent
+    {
+        char const * category = nullptr;
+        char const * name = nullptr;
+        qint64 begin = 0;
+        qint64 duration = 0;
+        int tab_id = 0;
+        QString detail;
+    };
+
+    //! Fixed size block of events. Only the owning thread writes events,
+    //! readers see all events below `used`.
+    struct TraceChunk
+    {
+        static constexpr int capacity = 1024;
+
+        TraceEvent events[capacity];
+        std::atomic<int> used { 0 };
+        std::atomic<TraceChunk *> next { nullptr };
+    };
+
+    struct ThreadBuffer
+    {
+        int thread_id = 0;
+        QString thread_name;
+        TraceChunk * head = nullptr;
+        TraceChunk * tail = nullptr;
+        ThreadBuffer * next = nullptr;
+    };
+
+    std::atomic<ThreadBuffer *> all_buffers { nullptr };
+    std::atomic<int> next_thread_id { 1 };
+    qint64 trace_origin = 0;
+    QString trace_file_name;
+
+    thread_local ThreadBuffer * local_buffer = nullptr;
+
+    ThreadBuffer * threadBuffer()
+    {
+        if(local_buffer != nullptr)
+            return local_buffer;
+
+        auto * buffer = new ThreadBuffer();
+        buffer->thread_id = next_thread_id.fetch_add(1);
+        buffer->thread_name = QThread::currentThread()->objectName();
+        if(buffer->thread_name.isEmpty()) {
+            if(QCoreApplication::instance() != nullptr and QThread::currentThread() == QCoreApplication::instance()->thread())
+                buffer->thread_name = "GUI";
+            else
+                buffer->thread_name = QString("Thread %1").arg(buffer->thread_id);
+        }
+        buffer->head = new TraceChunk();
+        buffer->tail = buffer->head;
+
+        // Lock-free push to the list of all buffers
+        buffer->next = all_buffers.load(std::memory_order_relaxed);
+        while(not all_buffers.compare_exchange_weak(buffer->next, buffer, std::memory_order_release, std::memory_order_relaxed)) {
+            // `buffer->next` was updated by compare_exchange_weak
+        }
+
+        local_buffer = buffer;
+        return buffer;
+    }
+}
+
+std::atomic<bool> Tracer::enabled { false };
+
+void Tracer::start(const QString &file_name)
+{
+    trace_file_name = file_name;
+    trace_origin = RequestTiming::now();
+    enabled.store(true);
+}
+
+bool Tracer::finish()
+{
+    if(not enabled.exchange(false))
+        return false;
+
+    QJsonArray events;
+
+    for(auto * buffer = all_buffers.load(std::memory_order_acquire); buffer != nullptr; buffer = buffer->next)
+    {
+        events.append(QJsonObject {
+            { "name", "thread_name" },
+            { "ph", "M" },
+            { "pid", 1 },
+            { "tid", buffer->thread_id },
+            { "args", QJsonObject { { "name", buffer->thread_name } } },
+        });
+
+        for(auto * chunk = buffer->head; chunk != nullptr; chunk = chunk->next.load(std::memory_order_acquire))
+        {
+            int const used = chunk->used.load(std::memory_order_acquire);
+            for(int i = 0; i < used; i++)
+            {
+                auto const & event = chunk->events[i];
+
+                QJsonObject args;
+                if(event.tab_id != 0)
+                    args.insert("tab", event.tab_id);
+                if(not event.detail.isEmpty())
+                    args.insert("detail", event.detail);
+
+                events.append(QJsonObject {
+                    { "name", event.name },
+                    { "cat", event.category },
+                    { "ph", "X" },
+                    { "ts", double(event.begin - trace_origin) },
+                    { "dur", double(event.duration) },
+                    { "pid", 1 },
+                    { "tid", buffer->thread_id },
+                    { "args", args },
+                });
+            }
+        }
+    }
+
+    QJsonObject root {
+        { "traceEvents", events },
+        { "displayTimeUnit", "ms" },
+    };
+
+    QFile file { trace_file_name };
+    if(not file.open(QFile::WriteOnly)) {
+        qWarning() << "Failed to write trace file" << trace_file_name << file.errorString();
+        return false;
+    }
+    file.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+    return true;
+}
+
+void Tracer::addSpan(const char *category, const char *name, qint64 begin, qint64 end, int tab_id, const QString &detail)
+{
+    if(not isEnabled())
+        return;
+
+    auto * buffer = threadBuffer();
+    auto * chunk = buffer->tail;
+
+    int index = chunk->used.load(std::memory_order_relaxed);
+    if(index == TraceChunk::capacity)
+    {
+        auto * fresh = new TraceChunk();
+        chunk->next.store(fresh, std::memory_order_release);
+        buffer->tail = fresh;
+        chunk = fresh;
+        index = 0;
+    }
+
+    auto & event = chunk->events[index];
+    event.category = category;
+    event.name = name;
+    event.begin = begin;
+    event.duration = std::max<qint64>(0, end - begin);
+    event.tab_id = tab_id;
+    event.detail = detail;
+
+    chunk->used.store(index + 1, std::memory_order_release);
+}
+
+void Tracer::addTiming(const RequestTiming &timing, int tab_id, const QUrl &url)
+{
+    if(not isEnabled())
+        return;
+
+    QString const detail = url.toString();
+
+    qint64 first = -1;
+    qint64 previous = -1;
+    for(int i = 0; i < RequestTiming::PhaseCount; i++)
+    {
+        auto const phase = RequestTiming::Phase(i);
+        if(not timing.has(phase))
+            continue;
+
+        if(previous >= 0) {
+            char const * category = (phase <= RequestTiming::Transferred) ? "network" : "render";
+            addSpan(category, RequestTiming::phaseName(phase), previous, timing.stamp(phase), tab_id, detail);
+        } else {
+            first = timing.stamp(phase);
+        }
+        previous = timing.stamp(phase);
+    }
+
+    if(first >= 0) {
+        addSpan("navigation", "navigation", first, previous, tab_id, detail);
+    }
+}
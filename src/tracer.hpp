@@ -0,0 +1,76 @@
+#ifndef TRACER_HPP
+#define TRACER_HPP
+
+#include <QString>
+#include <QUrl>
+#include <atomic>
+
+#include "requesttiming.hpp"
+
+//! Records spans into per-thread buffers and writes them as
+//! Chrome trace-event JSON (chrome://tracing, Perfetto).
+//! When tracing is not enabled, all recording functions only
+//! test a single flag.
+struct Tracer
+{
+    Tracer() = delete;
+
+    //! Enables tracing. The trace is written to `file_name` by `finish()`.
+    static void start(QString const & file_name);
+
+    //! Stops tracing and writes all recorded spans to the trace file.
+    static bool finish();
+
+    static bool isEnabled() {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+    //! Records a finished span from `begin` to `end`, both taken from `RequestTiming::now()`.
+    //! `category` and `name` must be string literals.
+    static void addSpan(char const * category, char const * name, qint64 begin, qint64 end, int tab_id = 0, QString const & detail = QString { });
+
+    //! Records one span per reached phase of `timing` and one span for the whole navigation.
+    static void addTiming(RequestTiming const & timing, int tab_id, QUrl const & url);
+
+private:
+    static std::atomic<bool> enabled;
+};
+
+//! Records a span for the lifetime of the object.
+class TraceScope
+{
+public:
+    TraceScope(char const * category, char const * name, int tab_id = 0) :
+        category(category),
+        name(name),
+        tab_id(tab_id),
+        begin(Tracer::isEnabled() ? RequestTiming::now() : -1)
+    {
+    }
+
+    TraceScope(char const * category, char const * name, int tab_id, QUrl const & url) :
+        TraceScope(category, name, tab_id)
+    {
+        if(this->begin >= 0)
+            this->url = url;
+    }
+
+    TraceScope(TraceScope const &) = delete;
+    TraceScope & operator=(TraceScope const &) = delete;
+
+    ~TraceScope()
+    {
+        if(this->begin >= 0) {
+            Tracer::addSpan(this->category, this->name, this->begin, RequestTiming::now(), this->tab_id, this->url.toString());
+        }
+    }
+
+private:
+    char const * category;
+    char const * name;
+    int tab_id;
+    qint64 begin;
+    QUrl url;
+};
+
+#endif // TRACER_HPP
@@ -1,18 +1,23 @@
 #include "webclient.hpp"
+#include "networkthread.hpp"
+#include "hostconnector.hpp"
+#include "networkaccess.hpp"
 
 #include <QNetworkRequest>
 #include <QNetworkReply>
 
 WebClient::WebClient(QObject *parent) :
     QObject(parent),
-    current_reply(nullptr)
+    is_waiting(false),
+    current_reply(nullptr),
+    timeout(this)
 {
-    manager.setRedirectPolicy(QNetworkRequest::NoLessSafeRedirectPolicy);
+    connect(&timeout, &RequestTimeout::expired, this, &WebClient::on_timeout);
 }
 
 WebClient::~WebClient()
 {
-
+    this->abortRequest();
 }
 
 bool WebClient::startRequest(const QUrl &url)
@@ -20,49 +25,107 @@ bool WebClient::startRequest(const QUrl &url)
     if(url.scheme() != "http" and url.scheme() != "https")
         return false;
 
-    if(this->current_reply != nullptr)
-        return true;
+    QMetaObject::invokeMethod(this, [this, url]() {
+        this->beginRequest(url);
+    }, Qt::QueuedConnection);
+
+    return true;
+}
+
+bool WebClient::isInProgress() const
+{
+    return this->is_waiting or (this->current_reply != nullptr);
+}
+
+bool WebClient::cancelRequest()
+{
+    NetworkThread::invokeBlocking(this, [this]() {
+        this->abortRequest();
+    });
+
+    return true;
+}
+
+void WebClient::beginRequest(const QUrl &url)
+{
+    if(this->isInProgress())
+        return;
 
     this->body.clear();
+    this->request_timing.start();
+    this->status_code = 0;
 
     QNetworkRequest request(url);
     request.setMaximumRedirectsAllowed(5);
     request.setAttribute(QNetworkRequest::FollowRedirectsAttribute, true);
 
-    this->current_reply = manager.get(request);
-    if(this->current_reply == nullptr)
-        return false;
+    this->is_waiting = true;
+    NetworkAccess::get(request, this, [this](QNetworkReply * reply) {
+        this->requestStarted(reply);
+    });
+}
+
+void WebClient::requestStarted(QNetworkReply *reply)
+{
+    this->is_waiting = false;
+    this->current_reply = reply;
+    reply->setParent(this);
 
+    connect(this->current_reply, &QNetworkReply::encrypted, this, &WebClient::on_encrypted);
+    connect(this->current_reply, &QNetworkReply::metaDataChanged, this, &WebClient::on_metaDataChanged);
     connect(this->current_reply, &QNetworkReply::readyRead, this, &WebClient::on_data);
     connect(this->current_reply, &QNetworkReply::finished, this,  &WebClient::on_finished);
 
-    return true;
+    // The network access manager doesn't report the connection phases,
+    // so the timeouts up to the response headers are combined.
+    timeout.arm(NetworkTimeouts::connect() + NetworkTimeouts::handshake() + NetworkTimeouts::firstByte(), "The host did not respond in time");
 }
 
-bool WebClient::isInProgress() const
-{
-    return (this->current_reply != nullptr);
-}
-
-bool WebClient::cancelRequest()
+void WebClient::abortRequest()
 {
+    timeout.stop();
+    if(this->is_waiting)
+    {
+        NetworkAccess::cancel(this);
+        this->is_waiting = false;
+    }
     if(this->current_reply != nullptr)
     {
+        // The reply finishes while aborting, which must not be reported
+        this->current_reply->disconnect(this);
         this->current_reply->abort();
+        this->current_reply->deleteLater();
         this->current_reply = nullptr;
     }
     this->body.clear();
-    return true;
+}
+
+void WebClient::on_encrypted()
+{
+    this->request_timing.mark(RequestTiming::Handshake);
+}
+
+void WebClient::on_metaDataChanged()
+{
+    this->request_timing.markOnce(RequestTiming::FirstByte);
+    timeout.arm(NetworkTimeouts::idle(), "The connection stalled");
 }
 
 void WebClient::on_data()
 {
+    this->request_timing.markOnce(RequestTiming::FirstByte);
+    timeout.arm(NetworkTimeouts::idle(), "The connection stalled");
     this->body.append(this->current_reply->readAll());
     emit this->requestProgress(this->body.size());
 }
 
 void WebClient::on_finished()
 {
+    timeout.stop();
+
+    this->request_timing.mark(RequestTiming::Transferred);
+    this->status_code = this->current_reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+
     if(this->current_reply->error() != QNetworkReply::NoError)
     {
         emit this->requestFailed(this->current_reply->errorString());
@@ -80,3 +143,17 @@ void WebClient::on_finished()
     this->current_reply->deleteLater();
     this->current_reply = nullptr;
 }
+
+void WebClient::on_timeout(const QString &message)
+{
+    if(this->current_reply != nullptr)
+    {
+        // Aborting finishes the reply, which must not be reported as a second failure
+        this->current_reply->disconnect(this);
+        this->current_reply->abort();
+        this->current_reply->deleteLater();
+        this->current_reply = nullptr;
+    }
+    this->body.clear();
+    emit this->requestFailed(message);
+}
@@ -2,7 +2,11 @@
 #define WEBCLIENT_HPP
 
 #include <QObject>
-#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <atomic>
+
+#include "requesttiming.hpp"
+#include "hostconnector.hpp"
 
 class WebClient: public QObject
 {
@@ -13,12 +17,27 @@ public:
 
     ~WebClient() override;
 
+    //! Starts the request on the thread of the client. Returns false if
+    //! `url` can't be handled by this client.
     bool startRequest(QUrl const & url);
 
+    //! Must be called on the thread of the client.
     bool isInProgress() const;
 
+    //! Cancels the current request and waits for the thread of the client to
+    //! do so. Signals that were queued before are still delivered.
     bool cancelRequest();
 
+    //! Phase timestamps of the current or last request
+    RequestTiming timing() const {
+        return request_timing.get();
+    }
+
+    //! Status code of the last response or 0 if none was received
+    int statusCode() const {
+        return status_code;
+    }
+
 signals:
     void requestProgress(qint64 transferred);
 
@@ -27,14 +46,28 @@ signals:
     void requestFailed(QString const & message);
 
 private slots:
+    void on_encrypted();
+    void on_metaDataChanged();
     void on_data();
     void on_finished();
+    void on_timeout(QString const & message);
+
+private:
+    void beginRequest(QUrl const & url);
+
+    //! Called by NetworkAccess once the request was sent.
+    void requestStarted(QNetworkReply * reply);
+
+    void abortRequest();
 
 private:
-    QNetworkAccessManager manager;
+    bool is_waiting;
     QNetworkReply * current_reply;
+    RequestTimeout timeout;
 
     QByteArray body;
+    SharedRequestTiming request_timing;
+    std::atomic<int> status_code { 0 };
 };
 
 #endif // WEBCLIENT_HPP